@@ -0,0 +1,189 @@
+/***********************************************************************
+bench.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+// Benchmarks the flip kernels on fixed schemes and seeds and prints one
+// JSON object, so results can be compared between commits. Build with
+// "make bench" and run from the repository root:
+//   ./flip_bench [steps] [output.json]
+
+# include "mm.hpp"
+# include "scan.hpp"
+# include <chrono>
+
+#ifndef GIT_COMMIT
+#define GIT_COMMIT "unknown"
+#endif
+
+int oldrank;
+string filename;
+int correctness_check = 1;
+int verify_rounds = 0;
+volatile sig_atomic_t termination_flag = 0;
+
+namespace{
+  typedef chrono::steady_clock Clock;
+
+  double since(Clock::time_point start){
+    return chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  // Writes the standard algorithm for <n,m,l> in the layout MM expects.
+  string standardscheme(int n, int m, int l){
+    bool isLargeFormat = (n > 9 || m > 9 || l > 9);
+    stringstream name;
+    name << "bench_" << n << m << l << (isLargeFormat ? ".lexp" : ".exp");
+    ofstream output(name.str());
+    for(int i = 1; i <= n; ++i){
+      for(int j = 1; j <= m; ++j){
+	for(int k = 1; k <= l; ++k){
+	  output << setfill('0');
+	  if(isLargeFormat){
+	    output << "(a" << setw(2) << i << setw(2) << j << ")*(b" << setw(2) << j << setw(2) << k << ")*(c" << setw(2) << k << setw(2) << i << ")" << endl;
+	  }else{
+	    output << "(a" << i << j << ")*(b" << j << k << ")*(c" << k << i << ")" << endl;
+	  }
+	}
+      }
+    }
+    output.close();
+    return name.str();
+  }
+
+  // Runs every measurement on one scheme and appends its JSON object.
+  //  flips_per_sec        flips without reductions
+  //  walk_flips_per_sec   flips with reductions, as in randompath
+  //  reductions_per_sec   reductions found during that walk
+  //  splits_per_sec       randomsplit calls with split distance 1
+  //  init_us, iscorrect_us  mean latency of one call
+  //  verify_us            mean latency of one round of probablycorrect
+  template<class T>
+  void measure(ostream &json, string name, string file, int n, int m, int l, int steps){
+    T s(file, n, m, l);
+    int startrank = s.rank;
+
+    T* t = s.clone();
+    Rng gen(1);
+    Clock::time_point start = Clock::now();
+    int flips = 0;
+    for(; flips < steps && t->flips[0].size() + t->flips[1].size() + t->flips[2].size() > 0; ++flips){
+      t->randomflip(gen, false);
+    }
+    double flipsecs = since(start);
+    delete t;
+
+    gen.seed(2);
+    start = Clock::now();
+    int walked = 0;
+    int reductions = 0;
+    for(; walked < steps && s.flips[0].size() + s.flips[1].size() + s.flips[2].size() > 0; ++walked){
+      reductions += s.randomflip(gen, true);
+    }
+    double walksecs = since(start);
+
+    // Splits need a free row. When the walk found no reduction a row is
+    // dropped; the scheme is then wrong, which does not matter for timing.
+    T* base = s.clone();
+    if(base->rank >= base->maxrank){
+      base->remove(base->rank - 1);
+    }
+    gen.seed(3);
+    int splits = steps / 100;
+    double splitsecs = 0;
+    t = base->clone();
+    for(int i = 0; i < splits; ++i){
+      if(t->rank >= t->maxrank){
+	delete t;
+	t = base->clone();
+      }
+      start = Clock::now();
+      t->randomsplit(gen, 1);
+      splitsecs += since(start);
+    }
+    delete t;
+    delete base;
+
+    // Up to 20 calls, stopping early after a quarter of a second
+    int reps;
+    start = Clock::now();
+    for(reps = 0; reps < 20 && (reps == 0 || since(start) < 0.25); ++reps){
+      s.init();
+    }
+    double initsecs = since(start) / reps;
+    bool correct = true;
+    start = Clock::now();
+    for(reps = 0; reps < 20 && (reps == 0 || since(start) < 0.25); ++reps){
+      correct &= s.iscorrect();
+    }
+    double correctsecs = since(start) / reps;
+    vector<uint64_t> probes;
+    start = Clock::now();
+    for(reps = 0; reps < 20 && (reps == 0 || since(start) < 0.25); ++reps){
+      correct &= probablycorrect(s.column(0), s.column(1), s.column(2), s.rank, n, m, l, 1, gen, probes);
+    }
+    double verifysecs = since(start) / reps;
+
+    json << fixed << setprecision(1)
+	 << "    {\"name\": \"" << name << "\", \"shape\": [" << n << ", " << m << ", " << l << "], "
+	 << "\"bits\": " << 8*sizeof(s.get(0,0)) << ", \"rank\": " << startrank << ", \"walk_rank\": " << s.rank << ",\n"
+	 << "     \"flips\": " << flips << ", \"flips_per_sec\": " << flips / flipsecs << ",\n"
+	 << "     \"walk_flips\": " << walked << ", \"walk_flips_per_sec\": " << walked / walksecs << ",\n"
+	 << "     \"reductions\": " << reductions << ", \"reductions_per_sec\": " << reductions / walksecs << ",\n"
+	 << "     \"splits\": " << splits << ", \"splits_per_sec\": " << splits / splitsecs << ",\n"
+	 << setprecision(3)
+	 << "     \"init_us\": " << initsecs * 1e6 << ", \"iscorrect_us\": " << correctsecs * 1e6
+	 << ", \"verify_us\": " << verifysecs * 1e6
+	 << ", \"correct\": " << (correct ? "true" : "false") << "}";
+  }
+}
+
+int main(int argc, char* argv[]){
+  int steps = 1000000;
+  if(argc >= 2){
+    steps = strtol(argv[1], NULL, 10);
+  }
+
+  stringstream json;
+  json << "{\n  \"commit\": \"" << GIT_COMMIT << "\",\n  \"eqmask\": \"" << eqmask_kernel()
+       << "\",\n  \"steps\": " << steps << ",\n  \"schemes\": [\n";
+
+  measure<MM>(json, "222", "222.exp", 2, 2, 2, steps);
+  json << ",\n";
+  measure<MM>(json, "333 x27", "solutions/3,3,3/x27/333.exp", 3, 3, 3, steps);
+  json << ",\n";
+  measure<MM>(json, "333 y23", "solutions/3,3,3/y23/k00000013698c56e.exp", 3, 3, 3, steps);
+  json << ",\n";
+  measure<MM>(json, "444 x64", "solutions/4,4,4/x64/444.exp", 4, 4, 4, steps);
+  json << ",\n";
+
+  string f999 = standardscheme(9, 9, 9);
+  measure<MM_big>(json, "999 standard", f999, 9, 9, 9, steps);
+  json << ",\n";
+  measure<MM_wide>(json, "999 standard", f999, 9, 9, 9, steps);
+  json << ",\n";
+  remove(f999.c_str());
+
+  string f121212 = standardscheme(12, 12, 12);
+  measure<MM_wide>(json, "121212 standard", f121212, 12, 12, 12, steps);
+  remove(f121212.c_str());
+
+  json << "\n  ]\n}\n";
+
+  if(argc >= 3){
+    ofstream output(argv[2]);
+    output << json.str();
+  }else{
+    cout << json.str();
+  }
+  return 0;
+}
@@ -0,0 +1,88 @@
+/***********************************************************************
+bexp.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "bexp.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool isbinary(const string &filename){
+  return filename.length() > 5 && filename.substr(filename.length() - 5) == ".bexp";
+}
+
+MappedScheme::MappedScheme(const string &filename) : header(NULL), words(NULL), base(MAP_FAILED), length(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if(fd == -1){
+    throw runtime_error("Cannot open " + filename + ": " + strerror(errno));
+  }
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(BexpHeader)){
+    close(fd);
+    throw runtime_error("Not a .bexp file: " + filename);
+  }
+  length = st.st_size;
+  base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED){
+    throw runtime_error("Cannot map " + filename + ": " + strerror(errno));
+  }
+  header = (const BexpHeader*)base;
+  words = (const uint64_t*)(header + 1);
+  // The factors are as wide as flip makes them for the shape
+  uint64_t n = header->n, m = header->m, l = header->l;
+  uint64_t largest = max(n*m, max(m*l, l*n));
+  uint32_t width = largest > 128 ? 4 : largest > 64 ? 2 : 1;
+  bool shaped = n > 0 && m > 0 && l > 0 && largest <= 256 && header->words == width && header->rank <= n*m*l;
+  size_t expected = sizeof(BexpHeader) + (size_t)3*header->rank*header->words*8;
+  if(memcmp(header->magic, "BEXP", 4) != 0 || header->version != BEXP_VERSION || !shaped || length != expected){
+    munmap(base, length);
+    throw runtime_error("Not a .bexp file: " + filename);
+  }
+}
+
+MappedScheme::~MappedScheme(){
+  munmap(base, length);
+}
+
+void writebinary(const string &filename, const BexpHeader &header, const uint64_t* const columns[3]){
+  size_t column = (size_t)header.rank*header.words*8;
+  vector<char> buffer(sizeof(BexpHeader) + 3*column);
+  memcpy(buffer.data(), &header, sizeof(BexpHeader));
+  for(int k = 0; k < 3; ++k){
+    memcpy(buffer.data() + sizeof(BexpHeader) + k*column, columns[k], column);
+  }
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd == -1){
+    throw runtime_error("Cannot create " + filename + ": " + strerror(errno));
+  }
+  size_t done = 0;
+  while(done < buffer.size()){
+    ssize_t n = write(fd, buffer.data() + done, buffer.size() - done);
+    if(n == -1 && errno == EINTR){
+      continue;
+    }
+    if(n <= 0){
+      close(fd);
+      throw runtime_error("Cannot write " + filename + ": " + strerror(errno));
+    }
+    done += n;
+  }
+  close(fd);
+}
@@ -0,0 +1,74 @@
+/***********************************************************************
+bexp.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef bexp_hpp__
+#define bexp_hpp__
+
+#include<cstdint>
+#include<string>
+
+using namespace std;
+
+// The binary scheme format (*.bexp). A 32 byte header is followed by the
+// a, b and c factors of all rows, one column after the other, each factor
+// being words little endian 64-bit words, least significant word first.
+// This is the layout of the columns of Tensor::data, so loading is a copy
+// of three blocks out of the mapped file.
+struct BexpHeader{
+  char magic[4];      // "BEXP"
+  uint32_t version;   // BEXP_VERSION
+  uint32_t n;         // shape of the MatMul: a is n x m, b is m x l, c is l x n
+  uint32_t m;
+  uint32_t l;
+  uint32_t rank;
+  uint32_t words;     // 64-bit words per factor
+  uint32_t reserved;  // 0
+};
+
+static_assert(sizeof(BexpHeader) == 32, "BexpHeader must be 32 bytes");
+
+const uint32_t BEXP_VERSION = 1;
+
+bool isbinary(const string &filename);
+
+// A .bexp file mapped read only. Throws runtime_error if the file cannot
+// be mapped or is not a well formed .bexp file: one whose shape has at
+// most 256 bits per factor, whose words are those flip uses for the shape
+// and whose rank is at most n*m*l.
+class MappedScheme{
+  public:
+  const BexpHeader* header;
+  const uint64_t* words;  // first word of column 0
+
+  MappedScheme(const string &filename);
+  ~MappedScheme();
+
+  // First word of column k.
+  const uint64_t* column(int k) const {
+    return words + (size_t)k*header->rank*header->words;
+  }
+
+  private:
+  void* base;
+  size_t length;
+
+  MappedScheme(const MappedScheme&);
+  MappedScheme& operator=(const MappedScheme&);
+};
+
+// Writes header and the three columns, each rank factors of header.words
+// words, with one write(). Throws runtime_error on failure.
+void writebinary(const string &filename, const BexpHeader &header, const uint64_t* const columns[3]);
+
+#endif
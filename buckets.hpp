@@ -0,0 +1,132 @@
+/***********************************************************************
+buckets.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef buckets_hpp__
+#define buckets_hpp__
+
+#include<vector>
+#include<cstdint>
+
+using namespace std;
+
+inline uint64_t hashfactor(unsigned long long x){
+  x ^= x >> 31;
+  x *= 0x9E3779B97F4A7C15ULL;
+  return x ^ (x >> 29);
+}
+
+inline uint64_t hashfactor(__uint128_t x){
+  return hashfactor((unsigned long long)(x >> 64) * 0xC2B2AE3D27D4EB4FULL ^ (unsigned long long)x);
+}
+
+// The rows of one column grouped by factor value. Each value present maps
+// to the head of a doubly linked list threaded through the rows, so moving
+// a row to a new value and listing the rows that share a value never scan
+// the whole tensor. The table uses linear probing and is sized for twice
+// the maximal rank, so it never needs to grow.
+template<class F>
+class Buckets{
+  public:
+  vector<F> keys;
+  vector<int> heads;  // -1 marks an empty slot
+  vector<int> nexts;
+  vector<int> prevs;
+  size_t mask;
+
+  Buckets() : mask(0) {}
+
+  void reset(int maxrows){
+    size_t cap = 16;
+    while(cap < 2*(size_t)maxrows){
+      cap <<= 1;
+    }
+    keys.assign(cap, F(0));
+    heads.assign(cap, -1);
+    nexts.assign(maxrows, -1);
+    prevs.assign(maxrows, -1);
+    mask = cap - 1;
+  }
+
+  int first(const F &value) const {
+    size_t slot = find(value);
+    return heads[slot];
+  }
+
+  int after(int row) const {
+    return nexts[row];
+  }
+
+  void insert(int row, const F &value){
+    size_t slot = find(value);
+    if(heads[slot] == -1){
+      keys[slot] = value;
+    }else{
+      prevs[heads[slot]] = row;
+    }
+    nexts[row] = heads[slot];
+    prevs[row] = -1;
+    heads[slot] = row;
+  }
+
+  void erase(int row, const F &value){
+    if(prevs[row] != -1){
+      nexts[prevs[row]] = nexts[row];
+    }else{
+      size_t slot = find(value);
+      heads[slot] = nexts[row];
+      if(heads[slot] == -1){
+	unslot(slot);
+      }
+    }
+    if(nexts[row] != -1){
+      prevs[nexts[row]] = prevs[row];
+    }
+  }
+
+  void move(int row, const F &from, const F &to){
+    erase(row, from);
+    insert(row, to);
+  }
+
+  private:
+  // The slot holding value, or the empty slot where it would go.
+  size_t find(const F &value) const {
+    size_t slot = hashfactor(value) & mask;
+    while(heads[slot] != -1 && !(keys[slot] == value)){
+      slot = (slot + 1) & mask;
+    }
+    return slot;
+  }
+
+  // Backward shift deletion, which keeps probe chains intact without
+  // tombstones.
+  void unslot(size_t hole){
+    size_t slot = hole;
+    while(true){
+      slot = (slot + 1) & mask;
+      if(heads[slot] == -1){
+	return;
+      }
+      size_t home = hashfactor(keys[slot]) & mask;
+      if(((slot - home) & mask) >= ((slot - hole) & mask)){
+	keys[hole] = keys[slot];
+	heads[hole] = heads[slot];
+	heads[slot] = -1;
+	hole = slot;
+      }
+    }
+  }
+};
+
+#endif
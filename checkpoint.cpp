@@ -0,0 +1,134 @@
+/***********************************************************************
+checkpoint.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "checkpoint.hpp"
+#include <cerrno>
+#include <cstdio>
+
+bool readcheckpoint(const string &path, CheckpointHeader &header, vector<WalkerSnapshot> &walkers){
+  ifstream input(path, ios::binary);
+  if(!input){
+    return false;
+  }
+  if(!input.read((char*)&header, sizeof(header)) || memcmp(header.magic, "FCKP", 4) != 0 || header.version != CHECKPOINT_VERSION){
+    throw runtime_error("Not a checkpoint file: " + path);
+  }
+  uint64_t n = header.n, m = header.m, l = header.l;
+  if(n == 0 || m == 0 || l == 0 || n*m > 256 || m*l > 256 || l*n > 256 || header.words == 0 || header.words > 4){
+    throw runtime_error("Malformed checkpoint file: " + path);
+  }
+  walkers.clear();
+  for(uint32_t i = 0; i < header.walkers; ++i){
+    walkers.emplace_back();
+    WalkerSnapshot &w = walkers.back();
+    if(!input.read((char*)&w.record, sizeof(WalkerRecord))){
+      throw runtime_error("Truncated checkpoint file: " + path);
+    }
+    if(w.record.rank < 0 || (uint64_t)w.record.rank > n*m*l){
+      throw runtime_error("Malformed checkpoint file: " + path);
+    }
+    w.words.resize((size_t)3*w.record.rank*header.words);
+    if(!input.read((char*)w.words.data(), w.words.size()*8)){
+      throw runtime_error("Truncated checkpoint file: " + path);
+    }
+  }
+  return true;
+}
+
+void writecheckpoint(const string &path, const CheckpointHeader &header, const vector<WalkerSnapshot> &walkers){
+  string partial = path + ".tmp";
+  {
+    ofstream output(partial, ios::binary | ios::trunc);
+    output.write((const char*)&header, sizeof(header));
+    for(auto &w : walkers){
+      output.write((const char*)&w.record, sizeof(WalkerRecord));
+      output.write((const char*)w.words.data(), w.words.size()*8);
+    }
+    if(!output.flush()){
+      throw runtime_error("Cannot write " + partial);
+    }
+  }
+  if(rename(partial.c_str(), path.c_str()) != 0){
+    throw runtime_error("Cannot replace " + path + ": " + strerror(errno));
+  }
+}
+
+Checkpointer::Checkpointer(string path, const CheckpointHeader &header, double interval)
+  : epoch(0), path(path), header(header), interval(interval), snapshots(header.walkers), saved(header.walkers, (unsigned)-1), stopped(false) {
+  if(interval > 0){
+    worker = thread(&Checkpointer::run, this);
+  }
+}
+
+Checkpointer::~Checkpointer(){
+  stop();
+}
+
+// seen is the epoch the walker paused for; a finished walker's state
+// stands for every later epoch.
+void Checkpointer::save(int walker, const WalkerSnapshot &snapshot, unsigned seen){
+  {
+    lock_guard<mutex> guard(lock);
+    snapshots[walker] = snapshot;
+    saved[walker] = seen;
+  }
+  wake.notify_all();
+}
+
+void Checkpointer::stop(){
+  {
+    lock_guard<mutex> guard(lock);
+    if(stopped){
+      return;
+    }
+    stopped = true;
+  }
+  wake.notify_all();
+  if(worker.joinable()){
+    worker.join();
+  }
+}
+
+bool Checkpointer::complete(){
+  for(size_t w = 0; w < snapshots.size(); ++w){
+    if(saved[w] != epoch.load() && !(saved[w] != (unsigned)-1 && snapshots[w].record.finished)){
+      return false;
+    }
+  }
+  return true;
+}
+
+void Checkpointer::run(){
+  unique_lock<mutex> guard(lock);
+  chrono::steady_clock::time_point due = chrono::steady_clock::now();
+  while(!stopped){
+    due += chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(interval));
+    if(wake.wait_until(guard, due, [this](){ return stopped; })){
+      break;
+    }
+    ++epoch;
+    wake.wait(guard, [this](){ return stopped || complete(); });
+    if(stopped){
+      break;
+    }
+    vector<WalkerSnapshot> copy = snapshots;
+    guard.unlock();
+    try{
+      writecheckpoint(path, header, copy);
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+    }
+    guard.lock();
+  }
+}
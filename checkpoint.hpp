@@ -0,0 +1,142 @@
+/***********************************************************************
+checkpoint.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef checkpoint_hpp__
+#define checkpoint_hpp__
+
+#include "tensor.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// A checkpoint file holds the state of every walker of a run: a 32 byte
+// header, then per walker an 80 byte WalkerRecord followed by its scheme as
+// 3*rank factors of words 64-bit words, column a, b, then c.
+struct CheckpointHeader{
+  char magic[4];     // "FCKP"
+  uint32_t version;  // CHECKPOINT_VERSION
+  uint32_t walkers;
+  int32_t oldrank;   // rank the run started from
+  uint32_t n;
+  uint32_t m;
+  uint32_t l;
+  uint32_t words;    // 64-bit words per factor
+};
+
+struct WalkerRecord{
+  uint64_t rng[4];
+  uint64_t bits;     // Rng::bits
+  int32_t nbits;
+  int32_t step;      // WalkProgress
+  int32_t start_rank;
+  int32_t rank;
+  uint32_t split_done;
+  uint32_t finished;
+  int64_t flips;
+  double seconds;
+};
+
+static_assert(sizeof(CheckpointHeader) == 32, "CheckpointHeader must be 32 bytes");
+static_assert(sizeof(WalkerRecord) == 80, "WalkerRecord must be 80 bytes");
+
+const uint32_t CHECKPOINT_VERSION = 2;
+
+struct WalkerSnapshot{
+  WalkerRecord record;
+  vector<uint64_t> words;
+};
+
+// Reads a checkpoint; false if there is no such file. Throws runtime_error
+// if it is malformed, including a shape beyond 256 bits per factor or a
+// walker whose rank is negative or above n*m*l.
+bool readcheckpoint(const string &path, CheckpointHeader &header, vector<WalkerSnapshot> &walkers);
+
+// Replaces path atomically by a new checkpoint. Throws runtime_error on
+// failure.
+void writecheckpoint(const string &path, const CheckpointHeader &header, const vector<WalkerSnapshot> &walkers);
+
+template<class F>
+void capture(Tensor<F> &t, const Rng &gen, const WalkProgress &progress, WalkerSnapshot &snapshot){
+  WalkerRecord &r = snapshot.record;
+  memcpy(r.rng, gen.s, sizeof(r.rng));
+  r.bits = gen.bits;
+  r.nbits = gen.nbits;
+  r.step = progress.step;
+  r.start_rank = progress.start_rank;
+  r.rank = t.rank;
+  r.split_done = progress.split_done;
+  r.finished = progress.finished;
+  r.flips = progress.flips;
+  r.seconds = progress.seconds;
+  int words = sizeof(F)/8;
+  snapshot.words.resize((size_t)3*t.rank*words);
+  for(int k = 0; k < 3; ++k){
+    memcpy(&snapshot.words[(size_t)k*t.rank*words], t.column(k), (size_t)t.rank*sizeof(F));
+  }
+}
+
+template<class F>
+void restore(Tensor<F> &t, Rng &gen, WalkProgress &progress, const WalkerSnapshot &snapshot){
+  const WalkerRecord &r = snapshot.record;
+  memcpy(gen.s, r.rng, sizeof(r.rng));
+  gen.bits = r.bits;
+  gen.nbits = r.nbits;
+  progress.step = r.step;
+  progress.start_rank = r.start_rank;
+  progress.split_done = r.split_done;
+  progress.finished = r.finished;
+  progress.flips = r.flips;
+  progress.seconds = r.seconds;
+  int words = sizeof(F)/8;
+  if(r.rank < 0 || r.rank > t.maxrank || snapshot.words.size() != (size_t)3*r.rank*words){
+    throw runtime_error("The checkpoint does not fit the scheme");
+  }
+  t.rank = r.rank;
+  for(int k = 0; k < 3; ++k){
+    memcpy((uint64_t*)t.column(k), &snapshot.words[(size_t)k*r.rank*words], (size_t)r.rank*sizeof(F));
+  }
+  t.init();
+}
+
+// Writes a checkpoint every interval seconds. It then moves epoch on, which
+// makes every walk pause; each walker hands over its state with save() and
+// carries on, and the file is written once all walkers, or their final
+// states, are in.
+class Checkpointer{
+  public:
+  atomic<unsigned> epoch;
+
+  Checkpointer(string path, const CheckpointHeader &header, double interval);
+  ~Checkpointer();
+
+  void save(int walker, const WalkerSnapshot &snapshot, unsigned seen);
+  void stop();
+
+  private:
+  string path;
+  CheckpointHeader header;
+  double interval;
+  vector<WalkerSnapshot> snapshots;
+  vector<unsigned> saved;  // epoch of each snapshot
+  mutex lock;
+  condition_variable wake;
+  bool stopped;
+  thread worker;
+
+  bool complete();
+  void run();
+};
+
+#endif
@@ -0,0 +1,74 @@
+/***********************************************************************
+convert.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+// Converts schemes between the .exp, .lexp and .bexp formats; the format
+// of each file is taken from its extension. Build with "make convert":
+//   ./flip_convert <input> <output> <dim 1> <dim 2> <dim 3>
+
+# include "mm.hpp"
+# include <stdexcept>
+
+int oldrank;
+string filename;
+int correctness_check = 1;
+int verify_rounds = 0;
+volatile sig_atomic_t termination_flag = 0;
+
+template<class F>
+int convert(string input, string output, int n, int m, int l){
+  try{
+    MatMul<F> s(input, n, m, l);
+    if(!s.iscorrect()){
+      cerr << "Opened incorrect scheme: " << input << endl;
+      return 1;
+    }
+    s.write(output);
+  }catch(const runtime_error &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]){
+  if(argc < 6 || argc > 7){
+    cerr << "Wrong number of arguments. Usage: " << endl;
+    cerr << argv[0] << " <input> <output> <dim 1> <dim 2> <dim 3> [correctness check]" << endl;
+    return 1;
+  }
+  string input = argv[1];
+  string output = argv[2];
+  int l = strtol(argv[3], NULL, 10);
+  int m = strtol(argv[4], NULL, 10);
+  int n = strtol(argv[5], NULL, 10);
+  if(argc >= 7){
+    correctness_check = strtol(argv[6], NULL, 10);
+  }
+
+  bool isBig = (l*m > 64 || m*n > 64 || n*l > 64);
+  bool isWide = (l*m > 128 || m*n > 128 || n*l > 128);
+  bool isTooBig = (l*m > 256 || m*n > 256 || n*l > 256);
+
+  if(isTooBig){
+    cerr << "Too big, all matrices must have dimension product most 256." << endl;
+    return 1;
+  }
+  if(isWide){
+    return convert<factor_wide>(input, output, n, m, l);
+  }
+  if(isBig){
+    return convert<factor_big>(input, output, n, m, l);
+  }
+  return convert<factor>(input, output, n, m, l);
+}
@@ -0,0 +1,389 @@
+/***********************************************************************
+descend.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#include "descend.hpp"
+#include "shmpool.hpp"
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <thread>
+
+// The schemes of one rank: its pool file, opened once the descent needs the
+// rank, and a copy of the entries in memory to draw seeds from.
+struct RankPool{
+  mutex lock;
+  atomic<bool> passed;      // the descent has left this rank; cancels its walks
+  bool loaded;              // the file has been looked for
+  unique_ptr<Pool> file;    // NULL while there is no file
+  vector<uint64_t> entries; // one after another, as in a pool record after the key
+  size_t count;
+
+  RankPool() : passed(false), loaded(false), count(0) {}
+};
+
+template<class F>
+class PoolDescent : public Descent{
+  public:
+  PoolDescent(const DescendSettings &settings);
+
+  bool walk(Rng &gen, bool &reduced);
+  int rank() const { return current.load(); }
+  void stop();
+
+  private:
+  vector<unique_ptr<RankPool>> pools;  // by rank
+  unique_ptr<ShmPool> shared;          // holds the schemes instead of pools, if not NULL
+  atomic<int> current;
+  atomic<int> reductions;  // new schemes below current
+  atomic<int> failures;    // walks from current that ended without a reduction
+  atomic<bool> ended;
+  mutex ladder;            // moving current, and reductions and failures with it
+
+  size_t words() const { return (size_t)3*sizeof(F)/8; }
+  string path(int r) const { return poolpath(settings.dir, settings.prefix, r); }
+  RankPool& load(int r);
+  size_t size(int r);
+  MatMul<F>* draw(int r, Rng &gen);
+  bool accept(MatMul<F> &t);
+  void fail(int r);
+};
+
+static bool exists(const string &path){
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+template<class F>
+PoolDescent<F>::PoolDescent(const DescendSettings &settings)
+  : Descent(settings), current(-1), reductions(0), failures(0), ended(false) {
+  int top = settings.n*settings.m*settings.l;
+  for(int r = 0; r <= top; ++r){
+    pools.emplace_back(new RankPool());
+  }
+  if(!settings.shm.empty()){
+    shared.reset(new ShmPool(settings.shm, settings.n, settings.m, settings.l, sizeof(F)/8, settings.shm_size));
+  }
+  for(int r = 0; r <= top && current == -1; ++r){
+    if((shared || exists(path(r))) && size(r) > 0){
+      current = r;
+    }
+  }
+  // An empty segment starts from the pool files
+  for(int r = 0; r <= top && shared && current == -1; ++r){
+    RankPool &p = load(r);
+    size_t w = words()*r;
+    for(size_t i = 0; i < p.count; ++i){
+      const uint64_t* columns[3] = {&p.entries[i*w], &p.entries[i*w + w/3], &p.entries[i*w + 2*w/3]};
+      uint64_t index;
+      shared->append(r, columns, index);
+      current = r;
+    }
+  }
+  if(current == -1){
+    throw runtime_error("No pool " + settings.prefix + "<rank>.pool with schemes in " + settings.dir);
+  }
+  cerr << name() << ": trying to reduce from rank " << current << endl;
+}
+
+// Reads the pool file of rank r into memory, the first time only.
+template<class F>
+RankPool& PoolDescent<F>::load(int r){
+  RankPool &p = *pools[r];
+  lock_guard<mutex> guard(p.lock);
+  if(p.loaded){
+    return p;
+  }
+  p.loaded = true;
+  if(!exists(path(r))){
+    return p;
+  }
+  p.file.reset(new Pool(path(r), true));
+  const PoolHeader &header = p.file->header;
+  if((int)header.n != settings.n || (int)header.m != settings.m || (int)header.l != settings.l || (int)header.rank != r || header.words != sizeof(F)/8){
+    throw runtime_error("The pool " + path(r) + " is of another shape, rank or word size");
+  }
+  uint64_t count = p.file->size();
+  vector<uint64_t> entry(words()*r);
+  for(uint64_t i = 0; i < count; ++i){
+    if(p.file->read(i, entry.data())){
+      p.entries.insert(p.entries.end(), entry.begin(), entry.end());
+      ++p.count;
+    }
+  }
+  return p;
+}
+
+template<class F>
+size_t PoolDescent<F>::size(int r){
+  if(shared){
+    return shared->size(r);
+  }
+  RankPool &p = load(r);
+  lock_guard<mutex> guard(p.lock);
+  return p.count;
+}
+
+template<class F>
+MatMul<F>* PoolDescent<F>::draw(int r, Rng &gen){
+  RankPool &p = *pools[r];
+  vector<uint64_t> entry(words()*r);
+  if(shared){
+    if(!shared->sample(r, gen, entry.data())){
+      return NULL;
+    }
+  }else{
+    lock_guard<mutex> guard(p.lock);
+    size_t i = gen.below(p.count);
+    copy(p.entries.begin() + i*entry.size(), p.entries.begin() + (i+1)*entry.size(), entry.begin());
+  }
+  int w = sizeof(F)/8;
+  const uint64_t* columns[3] = {entry.data(), entry.data() + (size_t)r*w, entry.data() + (size_t)2*r*w};
+  return new MatMul<F>(columns, r, w, settings.n, settings.m, settings.l);
+}
+
+template<class F>
+bool PoolDescent<F>::walk(Rng &gen, bool &reduced){
+  reduced = false;
+  int r = current.load();
+  if(ended || termination_flag){
+    return false;
+  }
+  RankPool &from = *pools[r];
+  unique_ptr<MatMul<F>> t(draw(r, gen));
+  if(!t){
+    // Only entries still being written or left by a crash
+    return true;
+  }
+  if(!t->iscorrect()){
+    cerr << "Incorrect scheme in " << path(r) << endl;
+    fail(r);
+    return true;
+  }
+  unique_ptr<VisitedFilter> visited;
+  t->check_reductions = settings.check_reductions;
+  t->stop_flag = &from.passed;
+  t->limits = &settings.limits;
+  if(settings.visited_bits > 0){
+    visited.reset(new VisitedFilter(settings.visited_bits));
+    t->visited = visited.get();
+    t->trackhash();
+  }
+  WalkProgress progress;
+  t->randompath(settings.pathlength, gen, settings.split_distance, settings.split, false, &progress);
+  t->visited = NULL;
+  if(!progress.finished){
+    // Cancelled
+    return !(ended || termination_flag);
+  }
+  if(r > t->rank){
+    reduced = accept(*t);
+  }else{
+    fail(r);
+  }
+  return true;
+}
+
+template<class F>
+bool PoolDescent<F>::accept(MatMul<F> &t){
+  lock_guard<mutex> guard(ladder);
+  int r = current.load();
+  if(ended || t.rank >= r){
+    return false;
+  }
+  vector<F> form = t.canonical();
+  const uint64_t* columns[3];
+  for(int k = 0; k < 3; ++k){
+    columns[k] = (const uint64_t*)&form[k*t.rank];
+  }
+  uint64_t index;
+  if(shared){
+    if(!shared->append(t.rank, columns, index)){
+      return false;
+    }
+    cout << settings.shm << ":" << t.rank << ":" << index << "," << t.rank << endl;
+  }else{
+    RankPool &to = load(t.rank);
+    lock_guard<mutex> pool(to.lock);
+    if(!to.file){
+      to.file.reset(new Pool(path(t.rank), settings.n, settings.m, settings.l, t.rank, sizeof(F)/8));
+    }
+    if(!to.file->append(columns, index)){
+      return false;
+    }
+    const uint64_t* begin = (const uint64_t*)form.data();
+    to.entries.insert(to.entries.end(), begin, begin + words()*t.rank);
+    ++to.count;
+    cout << path(t.rank) << ":" << index << "," << t.rank << endl;
+  }
+  if(++reductions < settings.reductions_needed){
+    return true;
+  }
+  int next = r - 1;
+  while(size(next) == 0){
+    --next;
+  }
+  pools[r]->passed = true;
+  reductions = 0;
+  failures = 0;
+  current = next;
+  cerr << name() << ": trying to reduce from rank " << next << endl;
+  return true;
+}
+
+template<class F>
+void PoolDescent<F>::fail(int r){
+  if(r != current.load() || ++failures < settings.failures_needed || reductions.load() > 0){
+    return;
+  }
+  lock_guard<mutex> guard(ladder);
+  if(!ended && r == current.load() && reductions.load() == 0){
+    cerr << name() << ": no reduction from rank " << r << " in " << failures.load() << " walks" << endl;
+    ended = true;
+    pools[r]->passed = true;
+  }
+}
+
+template<class F>
+void PoolDescent<F>::stop(){
+  lock_guard<mutex> guard(ladder);
+  ended = true;
+  pools[current.load()]->passed = true;
+}
+
+Descent* makedescent(const DescendSettings &settings){
+  int n = settings.n, m = settings.m, l = settings.l;
+  if(l*m > 128 || m*n > 128 || n*l > 128){
+    return new PoolDescent<factor_wide>(settings);
+  }
+  if(l*m > 64 || m*n > 64 || n*l > 64){
+    return new PoolDescent<factor_big>(settings);
+  }
+  return new PoolDescent<factor>(settings);
+}
+
+vector<DescendSettings> readtargets(const string &path, const DescendSettings &defaults){
+  ifstream input(path);
+  if(!input){
+    throw runtime_error("Cannot read " + path);
+  }
+  vector<DescendSettings> targets;
+  string line;
+  while(getline(input, line)){
+    istringstream words(line);
+    DescendSettings d = defaults;
+    string rest;
+    if(!(words >> d.dir) || d.dir[0] == '#'){
+      continue;
+    }
+    if(!(words >> d.prefix >> d.l >> d.m >> d.n) || (words >> rest)){
+      throw runtime_error("Targets are <shape dir> <prefix> <dim 1> <dim 2> <dim 3>: " + line);
+    }
+    if(d.l*d.m > 256 || d.m*d.n > 256 || d.n*d.l > 256){
+      throw runtime_error("Too big, all matrices must have dimension product most 256: " + line);
+    }
+    targets.push_back(d);
+  }
+  return targets;
+}
+
+int rundescents(const vector<Descent*> &descents, int nthreads, uint64_t seed){
+  nthreads = max(nthreads, 1);
+  vector<Rng> gens(nthreads, Rng(seed));
+  for(int t = 0; t < nthreads; ++t){
+    for(int j = 0; j < t; ++j){
+      gens[t].jump();
+    }
+  }
+  // Recent walks and new schemes of each descent, halved every
+  // DESCENT_WINDOW walks; a descent is live until its walk returns false.
+  size_t count = descents.size();
+  vector<double> walks(count, 0), found(count, 0);
+  vector<bool> live(count, true);
+  size_t running = count;
+  mutex lock;
+  atomic<int> failed(0);
+
+  // Draws the descent of the next walk, -1 once all have ended
+  auto choose = [&](Rng &gen){
+    lock_guard<mutex> guard(lock);
+    if(running == 0){
+      return -1;
+    }
+    vector<double> odds(count, 0);
+    double total = 0;
+    for(size_t i = 0; i < count; ++i){
+      if(live[i]){
+	odds[i] = (found[i] + 1) / (walks[i] + 2);
+	total += odds[i];
+      }
+    }
+    double x = (gen() >> 11) / 9007199254740992.0;
+    for(size_t i = 0; i < count; ++i){
+      if(live[i]){
+	x -= (1 - DESCENT_FLOOR)*odds[i]/total + DESCENT_FLOOR/running;
+	if(x < 0){
+	  return (int)i;
+	}
+      }
+    }
+    // Rounding
+    for(size_t i = count; i-- > 0; ){
+      if(live[i]){
+	return (int)i;
+      }
+    }
+    return -1;
+  };
+  auto work = [&](int t){
+    int i;
+    while((i = choose(gens[t])) != -1){
+      bool going, reduced = false;
+      try{
+	going = descents[i]->walk(gens[t], reduced);
+      }catch(const runtime_error &e){
+	cerr << descents[i]->name() << ": " << e.what() << endl;
+	failed = 1;
+	descents[i]->stop();
+	going = false;
+      }
+      lock_guard<mutex> guard(lock);
+      if(!going){
+	if(live[i]){
+	  live[i] = false;
+	  --running;
+	}
+	continue;
+      }
+      walks[i] += 1;
+      found[i] += reduced;
+      if(walks[i] >= 2*DESCENT_WINDOW){
+	walks[i] /= 2;
+	found[i] /= 2;
+      }
+    }
+  };
+  vector<thread> threads;
+  for(int t = 0; t < nthreads; ++t){
+    threads.push_back(thread(work, t));
+  }
+  for(auto &th : threads){
+    th.join();
+  }
+  return failed.load();
+}
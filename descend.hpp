@@ -0,0 +1,107 @@
+/***********************************************************************
+descend.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#ifndef descend_hpp__
+#define descend_hpp__
+
+#include "mm.hpp"
+
+// Settings of flip --descend, those of down.py and the walk options of flip.
+struct DescendSettings{
+  string dir;             // the shape directory with the pools <prefix><rank>.pool
+  string prefix;
+  int n;                  // shape as in MatMul
+  int m;
+  int l;
+  int pathlength;
+  int failures_needed;    // walks without a reduction that end the descent
+  int reductions_needed;  // new schemes below a rank that move the descent down
+  bool split;
+  int split_distance;
+  bool check_reductions;
+  int visited_bits;       // log2 of the bits of each walk's visited filter, 0 for none
+  WalkLimits limits;      // of each walk
+  string shm;             // shared memory segment holding the schemes instead of pools, none if empty
+  uint64_t shm_size;      // bytes of the segment if it is created
+};
+
+// The rank ladder of down.py in one process. Walks start from schemes drawn
+// at random from the pool of the current rank, which is kept in memory, and
+// end at their first reduction below it, as flip walks with restart 0 do. A
+// walk ending below the current rank is appended to the pool of its rank,
+// both the file and the copy in memory, and printed as <pool>:<index>,<rank>;
+// nothing else is written. Once reductions_needed schemes not yet in their
+// pools have been found, the descent moves down to the highest rank below
+// with schemes and cancels the walks still running from the rank it left.
+// It ends when failures_needed walks from the current rank have ended
+// without a reduction before any reduction from it was found.
+//
+// With a shared memory segment (see ShmPool), seeds are drawn from and
+// reductions appended to the segment, printed as <segment>:<rank>:<index>,
+// and no pool file is written; an empty segment is first filled from the
+// pool file of lowest rank. Descents of the same shape in other processes
+// then share their schemes, each with its own ladder.
+//
+// The ladder and its counters are atomics that walks read without a lock;
+// only accepting a reduction, rare next to the walks, takes the lock of the
+// ladder, and drawing a seed takes the lock of its pool for a copy.
+class Descent{
+  public:
+  const DescendSettings settings;
+
+  Descent(const DescendSettings &settings) : settings(settings) {}
+  virtual ~Descent() {}
+
+  // Runs one walk and accounts for its result, setting reduced to whether
+  // it found a new scheme below the current rank; false once the descent
+  // has ended or a signal has stopped it. Throws runtime_error if a pool
+  // cannot be read or written.
+  virtual bool walk(Rng &gen, bool &reduced) = 0;
+  virtual int rank() const = 0;
+  // Ends the descent and cancels its walks.
+  virtual void stop() = 0;
+
+  // <shape dir>/<prefix>, to tell descents apart in reports
+  string name() const { return settings.dir + "/" + settings.prefix; }
+};
+
+// The descent of the pools <prefix><rank>.pool in settings.dir, for the
+// factor type that fits the shape, starting from the lowest rank with
+// schemes. Throws runtime_error if there is none.
+Descent* makedescent(const DescendSettings &settings);
+
+// Reads the descents of a run of several shapes, one per line as
+// <shape dir> <prefix> <dim 1> <dim 2> <dim 3>, with the other settings
+// taken from defaults. Empty lines and lines starting with # are skipped.
+// Throws runtime_error if the file cannot be read or a line is malformed.
+vector<DescendSettings> readtargets(const string &path, const DescendSettings &defaults);
+
+// Runs walks of the descents on one pool of nthreads threads until all have
+// ended; thread t uses the stream of seed jumped t times. Walks are long
+// and independent, so instead of queues of tasks there is one choice: a
+// thread that is done with a walk takes its next one from a descent drawn
+// at random with odds proportional to its recent yield, the new schemes it
+// found per walk. Yields count the last DESCENT_WINDOW or so walks of each
+// descent, so threads move to the descents still finding reductions and
+// away from those stuck at a rank. A share DESCENT_FLOOR of the walks is
+// spread evenly, so that no descent starves and a stuck one can still run
+// the walks that end it. A descent whose walk fails with an error is
+// stopped and the others carry on. Returns 1 if one failed, else 0.
+const int DESCENT_WINDOW = 32;
+const double DESCENT_FLOOR = 0.1;
+
+int rundescents(const vector<Descent*> &descents, int nthreads, uint64_t seed);
+
+#endif
@@ -90,7 +90,7 @@ def flip_worker(thread_id, home_dir):
         #choose a file
         with lock[0]:
             input_file = get_random_file_from_dir(home_dir / f"{PREFIX}{current_rank[0]}")
-        proc = subprocess.Popen([f"./flip", input_file, n, m, l, PATHLENGTH, splits, "0", split_distance, "0"], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True) # Run a flip graph search with desired splits, no resets and *no correctness checks*.
+        proc = subprocess.Popen([f"./flip", input_file, n, m, l, PATHLENGTH, splits, "0", split_distance, "1"], stdout=subprocess.PIPE, stderr=subprocess.PIPE, text=True) # Run a flip graph search with desired splits, no resets and a correctness check of the input.
         out, err = proc.communicate()
         out = out.strip()
 
@@ -5,111 +5,757 @@ Copyright 2023 Jakob Moosbauer
  **********************************************************************/
 
 # include "mm.hpp"
-# include "mm_big.hpp"
+# include "bexp.hpp"
+# include "checkpoint.hpp"
+# include "serve.hpp"
+# include "descend.hpp"
+
+#include <cerrno>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
 
 int oldrank;
 string filename;
 int correctness_check = 1;
+int verify_rounds = 0;
+volatile sig_atomic_t termination_flag = 0;
 
-int main(int argc, char* argv[]){
-  debug("debugging enabled");
+// A second signal ends the program at once.
+void terminate_walks(int signal){
+  termination_flag = 1;
+  std::signal(signal, SIG_DFL);
+}
 
-  // Reading command line arguments and setting parameters
-  if(argc < 8 || argc > 11){
-    cerr << "Wrong number of arguments. Usage: " << endl;
-    cerr << argv[0] << " <filename> <dim 1> <dim 2> <dim 3> <path length> <split> <restart> [split distance] [correctness check] [seed]" << endl;
+// Settings of one run, as read from the command line.
+struct Params{
+  int pathlength;
+  bool split;
+  bool restart;
+  int split_distance;
+  long long seed;        // -1 for a random one
+  int nthreads;
+  double stats_interval;  // seconds between counter reports, 0 for none
+  string stats_file;      // where reports go, stderr if empty
+  long long pool_index;   // entry of a .pool input, -1 for a random one
+  bool check_reductions;  // check the scheme after every reduction
+  string checkpoint;      // checkpoint file, none if empty
+  double checkpoint_interval;  // seconds between checkpoints
+  WalkLimits limits;      // time, flips and target rank of each walk
+  int visited_bits;       // log2 of the bits of each walk's visited filter, 0 for none
+};
+
+// Runs nthreads independent walks on copies of s, each with its own
+// non-overlapping random stream. The first walker whose walk ends below
+// the starting rank cancels the rest. The lowest rank reached by any walk
+// is written out, preferring the walk that ended first. save(t, steps) writes the
+// result t. The rank, flips and time of every walk are reported on stderr,
+// with the share of flips that went back to a recently visited scheme if
+// the walks have visited filters.
+//
+// With a checkpoint file, the walks resume from it if it exists and their
+// state is written to it every checkpoint_interval seconds and when a
+// signal stops the run; it is removed once the run has ended by itself.
+template<class T, class Save>
+int runwalkers(T &s, const Params &p, Save save){
+  int nthreads = max(p.nthreads, 1);
+  int pathlength = p.pathlength;
+  long long seed = p.seed;
+  int split_distance = p.split_distance;
+  bool split = p.split;
+  bool restart = p.restart;
+  uint64_t base = seed;
+  if(seed == -1){
+    random_device rd;
+    base = (uint64_t)rd() << 32 | rd();
+  }
+
+  atomic<bool> stop(false);
+  atomic<int> winner(-1);
+  vector<T*> walkers(nthreads);
+  vector<int> steps(nthreads, 0);
+  vector<WalkProgress> progress(nthreads);
+  // Walker t uses the seed's stream jumped t times, so walker 0 repeats a
+  // single threaded run with the same seed.
+  vector<Rng> gens(nthreads, Rng(base));
+  for(int t = 0; t < nthreads; ++t){
+    walkers[t] = nthreads == 1 ? &s : s.clone();
+    walkers[t]->stop_flag = &stop;
+    walkers[t]->limits = &p.limits;
+    if(p.visited_bits > 0){
+      walkers[t]->visited = new VisitedFilter(p.visited_bits);
+      walkers[t]->trackhash();
+    }
+    for(int j = 0; j < t; ++j){
+      gens[t].jump();
+    }
+  }
+
+  CheckpointHeader header;
+  memcpy(header.magic, "FCKP", 4);
+  header.version = CHECKPOINT_VERSION;
+  header.walkers = nthreads;
+  header.oldrank = oldrank;
+  header.n = s.n;
+  header.m = s.m;
+  header.l = s.l;
+  header.words = sizeof(s.get(0,0))/8;
+  Checkpointer* checkpointer = NULL;
+  if(!p.checkpoint.empty()){
+    CheckpointHeader stored;
+    vector<WalkerSnapshot> resumed;
+    try{
+      if(readcheckpoint(p.checkpoint, stored, resumed)){
+	if(stored.walkers != header.walkers || stored.n != header.n || stored.m != header.m || stored.l != header.l || stored.words != header.words){
+	  cerr << "The checkpoint " << p.checkpoint << " is of another shape or number of threads" << endl;
+	  return 1;
+	}
+	oldrank = header.oldrank = stored.oldrank;
+	for(int t = 0; t < nthreads; ++t){
+	  restore(*walkers[t], gens[t], progress[t], resumed[t]);
+	}
+	cerr << "Resuming from " << p.checkpoint << endl;
+      }
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+    checkpointer = new Checkpointer(p.checkpoint, header, p.checkpoint_interval);
+    for(int t = 0; t < nthreads; ++t){
+      walkers[t]->checkpoint_epoch = &checkpointer->epoch;
+    }
+  }
+
+  vector<WalkStats> stats(nthreads);
+  vector<WalkStats*> counters;
+  for(auto &c : stats){
+    counters.push_back(&c);
+  }
+  for(int t = 0; t < nthreads; ++t){
+    walkers[t]->stats = counters[t];
+  }
+  StatsReporter* reporter = NULL;
+  if(p.stats_interval > 0 || !p.stats_file.empty()){
+    if(stats_enabled()){
+      reporter = new StatsReporter(counters, p.stats_interval, p.stats_file);
+    }else{
+      cerr << "Counters are not compiled in; rebuild with \"make stats\"." << endl;
+    }
+  }
+
+  auto walk = [&](int t){
+    T* w = walkers[t];
+    while(!progress[t].finished){
+      steps[t] = w->randompath(pathlength, gens[t], split_distance, split, restart, &progress[t]);
+      if(progress[t].finished || stop.load() || termination_flag){
+	break;
+      }
+      // Paused for a checkpoint
+      progress[t].epoch = checkpointer->epoch.load();
+      WalkerSnapshot snapshot;
+      capture(*w, gens[t], progress[t], snapshot);
+      checkpointer->save(t, snapshot, progress[t].epoch);
+    }
+    if(checkpointer != NULL && progress[t].finished){
+      WalkerSnapshot snapshot;
+      capture(*w, gens[t], progress[t], snapshot);
+      checkpointer->save(t, snapshot, progress[t].epoch);
+    }
+    int reached = w->rank;
+    if(reached < oldrank){
+      int none = -1;
+      if(winner.compare_exchange_strong(none, t)){
+	stop.store(true);
+      }
+    }
+  };
+  if(nthreads == 1){
+    walk(0);
+  }else{
+    vector<thread> threads;
+    for(int t = 0; t < nthreads; ++t){
+      threads.push_back(thread(walk, t));
+    }
+    for(auto &th : threads){
+      th.join();
+    }
+  }
+  delete reporter;
+  for(int t = 0; t < nthreads; ++t){
+    cerr << "walk " << t << ": rank " << walkers[t]->rank << " after " << progress[t].flips << " flips in " << progress[t].seconds << " s";
+    VisitedFilter* v = walkers[t]->visited;
+    if(v != NULL && v->added > 0){
+      cerr << ", " << 100.0*v->revisits/v->added << "% revisits";
+      if(v->streak >= VisitedFilter::TRAPPED_STREAK){
+	cerr << ", trapped";
+      }
+    }
+    cerr << endl;
+  }
+
+  int best = winner.load();
+  if(checkpointer != NULL){
+    checkpointer->stop();
+    // Walks stopped by a signal, unless one had already ended with a reduction
+    if(termination_flag && (best == -1 || !progress[best].finished)){
+      vector<WalkerSnapshot> snapshots(nthreads);
+      for(int t = 0; t < nthreads; ++t){
+	capture(*walkers[t], gens[t], progress[t], snapshots[t]);
+      }
+      try{
+	writecheckpoint(p.checkpoint, header, snapshots);
+	cerr << "Stopped by a signal; the walks resume from " << p.checkpoint << endl;
+      }catch(const runtime_error &e){
+	cerr << e.what() << endl;
+      }
+    }else{
+      remove(p.checkpoint.c_str());
+    }
+    delete checkpointer;
+  }
+
+  // A cancelled walk may have got lower than the winner, which only ended
+  // first; ties go to the winner.
+  if(best == -1){
+    best = 0;
+  }
+  for(int t = 0; t < nthreads; ++t){
+    int reached = walkers[t]->rank;
+    if(reached < walkers[best]->rank){
+      best = t;
+    }
+  }
+  save(*walkers[best], steps[best]);
+  for(auto w : walkers){
+    delete w->visited;
+    w->visited = NULL;
+  }
+  if(nthreads > 1){
+    for(auto w : walkers){
+      delete w;
+    }
+  }
+  return 0;
+}
+
+// Text schemes with a dimension above 9 need the two digit indices of .lexp.
+string textextension(int n, int m, int l){
+  return (n>9 || m>9 || l>9) ? ".lexp" : ".exp";
+}
+
+// The entry of the pool at path to start from: index, or one drawn with
+// seed if index is negative. Throws runtime_error if the pool is empty or
+// not named as poolpath names pools, since reductions go next to it.
+uint64_t pickentry(const Pool &pool, const string &path, long long index, long long seed){
+  string dir, prefix;
+  int rank;
+  if(!splitpoolpath(path, dir, prefix, rank)){
+    throw runtime_error("Pool files must be named <prefix><rank>.pool: " + path);
+  }
+  uint64_t count = pool.size();
+  if(count == 0){
+    throw runtime_error("The pool " + path + " is empty");
+  }
+  if(index >= 0){
+    return index;
+  }
+  Rng gen(seed == -1 ? random_device()() : seed);
+  return gen.below(count);
+}
+
+// Saves the result t of a walk from input, steps flips after its last
+// reduction, and returns the line reporting it. Results from a scheme file
+// are written in its format and reported as <file>,<rank>. Reductions from
+// a pool go into the pool of their rank next to it and are reported as
+// <pool>:<index>,<rank>; other results from a pool are dropped and
+// reported as -,<rank>. Throws runtime_error if the result cannot be
+// saved.
+template<class F>
+string saveresult(MatMul<F> &t, int steps, const string &input, bool frompool){
+  ostringstream report;
+  if(frompool){
+    if(t.rank >= oldrank){
+      report << "-," << t.rank;
+      return report.str();
+    }
+    string dir, prefix;
+    int rank;
+    splitpoolpath(input, dir, prefix, rank);
+    string path = poolpath(dir, prefix, t.rank);
+    Pool out(path, t.n, t.m, t.l, t.rank, sizeof(F)/8);
+    uint64_t index;
+    t.appendto(out, index);
+    report << path << ":" << index << "," << t.rank;
+    return report.str();
+  }
+  string extension = isbinary(input) ? ".bexp" : textextension(t.n, t.m, t.l);
+  string output = t.newfilename(extension);
+  t.write(output);
+  writelog(input, output, steps, oldrank, t.rank);
+  report << output << "," << t.rank;
+  return report.str();
+}
+
+// Reads the scheme with factors of type F and walks from it.
+template<class F>
+int run(int n, int m, int l, const Params &p){
+  unique_ptr<MatMul<F>> loaded;
+  bool frompool = ispool(filename);
+  try{
+    if(frompool){
+      Pool pool(filename);
+      uint64_t index = pickentry(pool, filename, p.pool_index, p.seed);
+      loaded.reset(new MatMul<F>(pool, index, n, m, l));
+    }else{
+      loaded.reset(new MatMul<F>(filename,n,m,l));
+    }
+  }catch(const runtime_error &e){
+    cerr << e.what() << endl;
     return 1;
   }
-  
-  filename = argv[1];
-  int l = strtol(argv[2], NULL, 10);
-  int m = strtol(argv[3], NULL, 10);
-  int n = strtol(argv[4], NULL, 10);
+  MatMul<F> &s = *loaded;
+  s.check_reductions = p.check_reductions;
 
-  bool isBig = (l*m > 64 || m*n > 64 || n*l > 64);
-  bool isTooBig = (l*m >128 || m*n > 128 || n*l > 128);
+  oldrank = s.rank;
 
-  if(isTooBig){
-    cerr << "Too big, all matrices must have dimension product most 128." << endl;
+  if(!s.iscorrect()){
+    cerr << "Opened incorrect scheme: " << filename << endl;
     return 1;
   }
 
-  int pathlength = strtol(argv[5],NULL,10);
-  bool split = strtol(argv[6],NULL,10);
-  bool restart = strtol(argv[7],NULL,10);
-  int split_distance = 10;
-  int seed = -1;
-  
-  if(argc >= 9){
-    split_distance = strtol(argv[8],NULL,10);
+  // Main call
+
+  int failed = 0;
+  int status = runwalkers(s, p, [&](MatMul<F> &t, int steps){
+      try{
+	cout << saveresult(t, steps, filename, frompool) << endl;
+      }catch(const runtime_error &e){
+	cerr << e.what() << endl;
+	failed = 1;
+      }
+    });
+  return status | failed;
+}
+
+// A job of flip --serve, given as one line
+//   <input> <path length> <split> <restart> [split distance] [seed] [print|write|none]
+// where input is a scheme file, a pool for a random entry of it, or
+// <pool>:<index>. The other settings are those of the command line.
+struct Job{
+  string input;
+  long long pool_index;  // -1 for a random entry
+  string mode;
+  Params p;
+};
+
+long long tonumber(const string &word){
+  char* end;
+  errno = 0;
+  long long value = strtoll(word.c_str(), &end, 10);
+  if(word.empty() || *end != '\0' || errno != 0){
+    throw runtime_error("Not a number: " + word);
   }
-  
-  if(argc >= 10){
-    correctness_check = strtol(argv[9],NULL,10);
+  return value;
+}
+
+// Throws runtime_error if line is not a job.
+Job parsejob(const string &line, const Params &defaults){
+  istringstream in(line);
+  vector<string> words;
+  string word;
+  while(in >> word){
+    words.push_back(word);
   }
-  
-  if(argc >= 11){
-    seed = strtol(argv[10],NULL,10);
+  Job job;
+  job.p = defaults;
+  job.mode = "print";
+  if(!words.empty() && (words.back() == "print" || words.back() == "write" || words.back() == "none")){
+    job.mode = words.back();
+    words.pop_back();
   }
-  
+  if(words.size() < 4 || words.size() > 6){
+    throw runtime_error("Jobs are <input> <path length> <split> <restart> [split distance] [seed] [print|write|none]");
+  }
+  job.input = words[0];
+  job.pool_index = -1;
+  size_t colon = job.input.rfind(':');
+  if(colon != string::npos && ispool(job.input.substr(0, colon))){
+    job.pool_index = tonumber(job.input.substr(colon + 1));
+    job.input.erase(colon);
+    if(job.pool_index < 0){
+      throw runtime_error("Not a pool index: " + words[0]);
+    }
+  }
+  job.p.pathlength = tonumber(words[1]);
+  job.p.split = tonumber(words[2]);
+  job.p.restart = tonumber(words[3]);
+  job.p.split_distance = words.size() > 4 ? tonumber(words[4]) : 10;
+  job.p.seed = words.size() > 5 ? tonumber(words[5]) : -1;
+  return job;
+}
 
-  // Reading the scheme
+// The jobs of flip --serve, run one at a time; a job still walks on
+// several threads with --threads. Seeds are read and checked
+// once and kept, keyed by their input, so a later job from the same seed
+// only copies it. Scheme files must not change while the server runs;
+// pools may grow. The cache is emptied once it holds SEED_CACHE schemes.
+template<class F>
+class Server{
+  public:
+  static const size_t SEED_CACHE = 1024;
 
-  if(isBig){
-    MM_big s = MM_big(filename,n,m,l);
+  Server(int n, int m, int l, const Params &defaults) : n(n), m(m), l(l), defaults(defaults) {}
 
-    oldrank = s.rank;
-
-    if(!s.iscorrect()){
-      cerr << "Opened incorrect scheme: " << filename << endl;
-      return 1;
+  // Runs the job given by line and returns the reply. In print mode, the
+  // default, the reply is <file>,<rank> naming the file the result would
+  // be written to, then the rows of the scheme as in a .exp or .lexp file
+  // and an empty line, and nothing is written. In write mode the result is
+  // saved as flip saves it and the reply is the line flip prints; in none
+  // mode only <file>,<rank> is sent. A job that fails gets
+  // "error <reason>".
+  string handle(const string &line){
+    try{
+      Job job = parsejob(line, defaults);
+      MatMul<F> s(seed(job));
+      s.check_reductions = job.p.check_reductions;
+      oldrank = s.rank;
+      filename = job.input;
+      string reply, failure;
+      int status = runwalkers(s, job.p, [&](MatMul<F> &t, int steps){
+	  try{
+	    reply = result(t, steps, job);
+	  }catch(const runtime_error &e){
+	    failure = e.what();
+	  }
+	});
+      if(!failure.empty()){
+	throw runtime_error(failure);
+      }
+      if(status != 0){
+	throw runtime_error("The walk failed; see the server's stderr");
+      }
+      return reply;
+    }catch(const runtime_error &e){
+      return string("error ") + e.what() + "\n";
     }
+  }
 
+  private:
+  int n;
+  int m;
+  int l;
+  Params defaults;
+  map<string, unique_ptr<MatMul<F>>> seeds;
+  map<string, unique_ptr<Pool>> pools;
 
-    // Setting up random number generator
+  MatMul<F>& seed(const Job &job){
+    string key = job.input;
+    uint64_t index = 0;
+    bool frompool = ispool(job.input);
+    if(frompool){
+      unique_ptr<Pool> &pool = pools[job.input];
+      if(!pool){
+	pool.reset(new Pool(job.input));
+      }
+      index = pickentry(*pool, job.input, job.pool_index, job.p.seed);
+      key += ":" + to_string(index);
+    }
+    auto found = seeds.find(key);
+    if(found != seeds.end()){
+      return *found->second;
+    }
+    unique_ptr<MatMul<F>> loaded(frompool ? new MatMul<F>(*pools[job.input], index, n, m, l) : new MatMul<F>(job.input, n, m, l));
+    if(!loaded->iscorrect()){
+      throw runtime_error("Incorrect scheme: " + key);
+    }
+    if(seeds.size() >= SEED_CACHE){
+      seeds.clear();
+    }
+    return *(seeds[key] = move(loaded));
+  }
 
-    mt19937 gen;
-    if(seed == -1){
-      random_device rd;
-      gen.seed(rd());
+  string result(MatMul<F> &t, int steps, const Job &job){
+    if(job.mode == "write"){
+      return saveresult(t, steps, job.input, ispool(job.input)) + "\n";
     }
-    else{
-      gen.seed(seed);
+    ostringstream reply;
+    reply << t.newfilename(textextension(n, m, l)) << "," << t.rank << endl;
+    if(job.mode == "print"){
+      t.writetext(reply, n > 9 || m > 9 || l > 9);
+      reply << endl;
     }
+    return reply.str();
+  }
+};
 
-    bool isLargeFormat = (n>9 || m>9 || l>9);
+// Runs jobs read line by line from stdin, or from the clients of a Unix
+// socket at socketpath one client at a time, and sends each reply back
+// where its job came from. Empty lines and lines starting with # are
+// skipped. Ends at the end of stdin, or on SIGINT or SIGTERM once the job
+// being run has been answered.
+template<class F>
+int serve(int n, int m, int l, const Params &defaults, const string &socketpath){
+  Server<F> server(n, m, l, defaults);
+  signal(SIGPIPE, SIG_IGN);
+  auto jobs = [&](int in, int out){
+    LineReader reader(in);
+    string line;
+    while(reader.next(line)){
+      size_t start = line.find_first_not_of(" \t");
+      if(start == string::npos || line[start] == '#'){
+	continue;
+      }
+      if(!writeall(out, server.handle(line))){
+	break;
+      }
+    }
+  };
+  if(socketpath.empty()){
+    jobs(0, 1);
+    return 0;
+  }
+  int listener;
+  try{
+    listener = listenon(socketpath);
+  }catch(const runtime_error &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+  cerr << "Listening on " << socketpath << endl;
+  int client;
+  while((client = acceptnext(listener)) >= 0){
+    jobs(client, client);
+    close(client);
+  }
+  close(listener);
+  unlink(socketpath.c_str());
+  return 0;
+}
 
-    // Main call
+int main(int argc, char* argv[]){
+  debug("debugging enabled");
 
-    s.randompath(pathlength, gen, split_distance, split, restart, isLargeFormat);
-  }else{
-    MM s = MM(filename,n,m,l);
+  // Options of the form --name value may appear anywhere; everything else
+  // is positional.
+  int nthreads = 1;
+  double stats_interval = 0;
+  string stats_file;
+  long long pool_index = -1;
+  bool check_reductions = false;
+  string checkpoint;
+  double checkpoint_interval = 300;
+  WalkLimits limits;
+  int visited_bits = 0;
+  bool serving = false;
+  bool descending = false;
+  string targets;
+  string shm;
+  uint64_t shm_size = (uint64_t)1024 << 20;
+  string socketpath;
+  vector<char*> args;
+  for(int i = 0; i < argc; ++i){
+    string arg = argv[i];
+    if(arg == "--threads" && i + 1 < argc){
+      nthreads = strtol(argv[++i], NULL, 10);
+    }else if(arg == "--stats-interval" && i + 1 < argc){
+      stats_interval = strtod(argv[++i], NULL);
+    }else if(arg == "--stats-file" && i + 1 < argc){
+      stats_file = argv[++i];
+    }else if(arg == "--verify-rounds" && i + 1 < argc){
+      verify_rounds = strtol(argv[++i], NULL, 10);
+    }else if(arg == "--checkpoint" && i + 1 < argc){
+      checkpoint = argv[++i];
+    }else if(arg == "--checkpoint-interval" && i + 1 < argc){
+      checkpoint_interval = strtod(argv[++i], NULL);
+    }else if(arg == "--time-limit" && i + 1 < argc){
+      limits.seconds = strtod(argv[++i], NULL);
+    }else if(arg == "--flip-budget" && i + 1 < argc){
+      limits.flips = strtoll(argv[++i], NULL, 10);
+    }else if(arg == "--target-rank" && i + 1 < argc){
+      limits.target_rank = strtol(argv[++i], NULL, 10);
+    }else if(arg == "--visited-filter" && i + 1 < argc){
+      visited_bits = strtol(argv[++i], NULL, 10);
+    }else if(arg == "--serve"){
+      serving = true;
+    }else if(arg == "--descend"){
+      descending = true;
+    }else if(arg == "--targets" && i + 1 < argc){
+      targets = argv[++i];
+    }else if(arg == "--shm" && i + 1 < argc){
+      shm = argv[++i];
+    }else if(arg == "--shm-size" && i + 1 < argc){
+      shm_size = strtoull(argv[++i], NULL, 10) << 20;
+    }else if(arg == "--socket" && i + 1 < argc){
+      socketpath = argv[++i];
+    }else if(arg == "--check-reductions"){
+      check_reductions = true;
+    }else if(arg == "--pool-index" && i + 1 < argc){
+      pool_index = strtoll(argv[++i], NULL, 10);
+    }else{
+      args.push_back(argv[i]);
+    }
+  }
+  argc = args.size();
+  argv = args.data();
 
-    oldrank = s.rank;
+  signal(SIGINT, terminate_walks);
+  signal(SIGTERM, terminate_walks);
 
-    if(!s.iscorrect()){
-      cerr << "Opened incorrect scheme: " << filename << endl;
+  // flip --descend takes the arguments of down.py; with --targets the
+  // shapes come from a file and only the settings are given.
+  if(descending){
+    int first = targets.empty() ? 6 : 1;
+    if(argc < first || argc > first + 6){
+      cerr << "Wrong number of arguments. Usage: " << endl;
+      cerr << argv[0] << " --descend [--threads N] [--verify-rounds R] [--check-reductions] [--time-limit S] [--flip-budget N] [--visited-filter B] [--shm NAME] [--shm-size MB] <shape dir> <prefix> <dim 1> <dim 2> <dim 3> [path length] [failed reductions needed] [reductions needed] [split] [split distance] [seed]" << endl;
+      cerr << argv[0] << " --descend --targets F [options] [path length] [failed reductions needed] [reductions needed] [split] [split distance] [seed]" << endl;
+      return 1;
+    }
+    if(serving || !checkpoint.empty()){
+      cerr << "--descend does not work with --serve or --checkpoint" << endl;
       return 1;
     }
+    DescendSettings d;
+    d.pathlength = argc > first ? strtol(argv[first], NULL, 10) : 10000000;
+    d.failures_needed = argc > first + 1 ? strtol(argv[first + 1], NULL, 10) : 100;
+    d.reductions_needed = argc > first + 2 ? strtol(argv[first + 2], NULL, 10) : 25;
+    d.split = argc > first + 3 ? strtol(argv[first + 3], NULL, 10) : 1;
+    d.split_distance = argc > first + 4 ? strtol(argv[first + 4], NULL, 10) : 1;
+    d.check_reductions = check_reductions;
+    d.visited_bits = visited_bits;
+    d.limits = limits;
+    d.shm = shm;
+    d.shm_size = shm_size;
+    uint64_t seed;
+    if(argc > first + 5){
+      seed = strtoull(argv[first + 5], NULL, 10);
+    }else{
+      random_device rd;
+      seed = (uint64_t)rd() << 32 | rd();
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    vector<Descent*> descents;
+    int status = 1;
+    try{
+      vector<DescendSettings> shapes;
+      if(targets.empty()){
+	d.dir = argv[1];
+	d.prefix = argv[2];
+	d.l = strtol(argv[3], NULL, 10);
+	d.m = strtol(argv[4], NULL, 10);
+	d.n = strtol(argv[5], NULL, 10);
+	if(d.l*d.m > 256 || d.m*d.n > 256 || d.n*d.l > 256){
+	  throw runtime_error("Too big, all matrices must have dimension product most 256.");
+	}
+	shapes.push_back(d);
+      }else{
+	shapes = readtargets(targets, d);
+	// One segment per shape
+	for(auto &shape : shapes){
+	  if(!shm.empty()){
+	    shape.shm = shm + "-" + to_string(shape.l) + "x" + to_string(shape.m) + "x" + to_string(shape.n);
+	  }
+	}
+      }
+      for(auto &shape : shapes){
+	descents.push_back(makedescent(shape));
+      }
+      status = rundescents(descents, nthreads, seed);
+      for(auto descent : descents){
+	cerr << descent->name() << ": finished at rank " << descent->rank() << endl;
+      }
+      cerr << "Finished after " << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s" << endl;
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+    }
+    for(auto descent : descents){
+      delete descent;
+    }
+    return status;
+  }
+
+  // Reading command line arguments and setting parameters
+  if(serving && (argc < 4 || argc > 5)){
+    cerr << "Wrong number of arguments. Usage: " << endl;
+    cerr << argv[0] << " --serve [--socket P] [--threads N] [--verify-rounds R] [--check-reductions] [--time-limit S] [--flip-budget N] [--target-rank R] [--visited-filter B] <dim 1> <dim 2> <dim 3> [correctness check]" << endl;
+    return 1;
+  }
+  if(!serving && (argc < 8 || argc > 11)){
+    cerr << "Wrong number of arguments. Usage: " << endl;
+    cerr << argv[0] << " [--threads N] [--stats-interval S] [--stats-file F] [--pool-index I] [--verify-rounds R] [--check-reductions] [--checkpoint F] [--checkpoint-interval S] [--time-limit S] [--flip-budget N] [--target-rank R] [--visited-filter B] <filename> <dim 1> <dim 2> <dim 3> <path length> <split> <restart> [split distance] [correctness check] [seed]" << endl;
+    cerr << argv[0] << " --serve [--socket P] [options] <dim 1> <dim 2> <dim 3> [correctness check]" << endl;
+    return 1;
+  }
+  if(serving && !checkpoint.empty()){
+    cerr << "--checkpoint does not work with --serve" << endl;
+    return 1;
+  }
 
+  // With --serve the input and the walk come with each job and the
+  // dimensions come first.
+  int dims = serving ? 1 : 2;
+  if(!serving){
+    filename = argv[1];
+  }
+  int l = strtol(argv[dims], NULL, 10);
+  int m = strtol(argv[dims + 1], NULL, 10);
+  int n = strtol(argv[dims + 2], NULL, 10);
 
-    // Setting up random number generator
+  bool isBig = (l*m > 64 || m*n > 64 || n*l > 64);
+  bool isWide = (l*m > 128 || m*n > 128 || n*l > 128);
+  bool isTooBig = (l*m > 256 || m*n > 256 || n*l > 256);
 
-    mt19937 gen;
-    if(seed == -1){
-      random_device rd;
-      gen.seed(rd());
-    }
-    else{
-      gen.seed(seed);
+  if(isTooBig){
+    cerr << "Too big, all matrices must have dimension product most 256." << endl;
+    return 1;
+  }
+
+  int pathlength = 0;
+  bool split = false;
+  bool restart = false;
+  int split_distance = 10;
+  long long seed = -1;
+
+  if(serving){
+    if(argc >= 5){
+      correctness_check = strtol(argv[4],NULL,10);
     }
+  }else{
+    pathlength = strtol(argv[5],NULL,10);
+    split = strtol(argv[6],NULL,10);
+    restart = strtol(argv[7],NULL,10);
 
-    bool isLargeFormat = (n>9 || m>9 || l>9);
+    if(argc >= 9){
+      split_distance = strtol(argv[8],NULL,10);
+    }
 
-    // Main call
+    if(argc >= 10){
+      correctness_check = strtol(argv[9],NULL,10);
+    }
 
-    s.randompath(pathlength, gen, split_distance, split, restart, isLargeFormat);
+    if(argc >= 11){
+      seed = strtoll(argv[10],NULL,10);
+    }
   }
 
-  return 0;
+  Params p = {pathlength, split, restart, split_distance, seed, nthreads, stats_interval, stats_file, pool_index, check_reductions, checkpoint, checkpoint_interval, limits, visited_bits};
+  if(serving){
+    if(isWide){
+      return serve<factor_wide>(n, m, l, p, socketpath);
+    }
+    if(isBig){
+      return serve<factor_big>(n, m, l, p, socketpath);
+    }
+    return serve<factor>(n, m, l, p, socketpath);
+  }
+  if(isWide){
+    return run<factor_wide>(n, m, l, p);
+  }
+  if(isBig){
+    return run<factor_big>(n, m, l, p);
+  }
+  return run<factor>(n, m, l, p);
 }
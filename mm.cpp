@@ -14,18 +14,33 @@ You should have received a copy of the GNU General Public License along with big
  **********************************************************************/
 
 #include "mm.hpp"
+#include "bexp.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
-MM::MM(string filename, int n, int m, int l) : Tensor(){
+template<class F>
+void MatMul<F>::setup(int n, int m, int l){
   this->n = n;
   this->m = m;
   this->l = l;
-  
-  maxrank = n*m*l;
+  this->maxrank = n*m*l;
+  this->data = new F[3*this->maxrank];
+  this->rank = 0;
+  this->flips = new PairSet[3];
+  this->buckets = new Buckets<F>[3];
+}
+
+template<class F>
+MatMul<F>::MatMul(string filename, int n, int m, int l) : Tensor<F>(){
+  setup(n, m, l);
+  int &rank = this->rank;
 
-  //  cout << "Reading scheme from file " << filename << endl;
-  //  cout << "setting maxrank to " << maxrank << endl;
-  data = new factor[3*maxrank];
-  rank = 0;
+  if(isbinary(filename)){
+    loadbinary(filename);
+    this->init();
+    return;
+  }
 
   bool isLargeFormat = false;
   if(filename.length() > 5 && filename.substr(filename.length() - 5) == ".lexp"){
@@ -42,29 +57,253 @@ MM::MM(string filename, int n, int m, int l) : Tensor(){
     a = line.substr(0,d1);
     b = line.substr(d1+1, d2-d1-1);
     c = line.substr(d2+1);
-    parseMatrix(a,'a',m,data+3*rank, isLargeFormat);
-    parseMatrix(b,'b',l,data+3*rank+1, isLargeFormat);
-    parseMatrix(c,'c',n,data+3*rank+2, isLargeFormat);
+    parseMatrix(a,'a',m,&this->get(rank,0), isLargeFormat);
+    parseMatrix(b,'b',l,&this->get(rank,1), isLargeFormat);
+    parseMatrix(c,'c',n,&this->get(rank,2), isLargeFormat);
     ++rank;
   }
   input.close();
 
-  flips = new PairSet[3];
-  init();
+  this->init();
+}
+
+template<class F>
+MatMul<F>::MatMul(const Pool &pool, uint64_t index, int n, int m, int l) : Tensor<F>(){
+  setup(n, m, l);
+  const PoolHeader &header = pool.header;
+  if((int)header.n != n || (int)header.m != m || (int)header.l != l){
+    throw runtime_error("The shape of the pool does not match the given dimensions");
+  }
+  vector<uint64_t> words((size_t)3*header.rank*header.words);
+  if(!pool.read(index, words.data())){
+    throw runtime_error("The pool has no entry " + to_string(index));
+  }
+  const uint64_t* columns[3];
+  for(int k = 0; k < 3; ++k){
+    columns[k] = words.data() + (size_t)k*header.rank*header.words;
+  }
+  loadcolumns(columns, header.rank, header.words, "the pool");
+  this->init();
+}
+
+template<class F>
+MatMul<F>::MatMul(const uint64_t* const columns[3], int rank, int words, int n, int m, int l) : Tensor<F>(){
+  setup(n, m, l);
+  loadcolumns(columns, rank, words, "the scheme");
+  this->init();
+}
+
+template<class F>
+MatMul<F>::MatMul(const uint64_t* const columns[3], int rank, int words, int oldn, int oldm, int oldl, int n, int m, int l) : Tensor<F>(){
+  if(n < oldn || m < oldm || l < oldl){
+    throw runtime_error("The new shape must contain the old one");
+  }
+  setup(n, m, l);
+  if(rank + n*m*l - oldn*oldm*oldl > this->maxrank){
+    throw runtime_error("Rank of the expanded scheme exceeds the maximum rank");
+  }
+  loadcolumns(columns, rank, words, "the scheme");
+  for(int r = 0; r < rank; ++r){
+    F &a = this->get(r,0), &b = this->get(r,1), &c = this->get(r,2);
+    a = embedm(a, oldn, oldm, m);
+    b = embedm(b, oldm, oldl, l);
+    c = embedm(c, oldl, oldn, n);
+  }
+  int &r = this->rank;
+  for(int i = 1; i <= n; ++i){
+    for(int j = 1; j <= m; ++j){
+      for(int k = 1; k <= l; ++k){
+	if(i <= oldn && j <= oldm && k <= oldl){
+	  continue;
+	}
+	F a = 0, b = 0, c = 0;
+	setm(a, m, i, j);
+	setm(b, l, j, k);
+	setm(c, n, k, i);
+	this->get(r,0) = a;
+	this->get(r,1) = b;
+	this->get(r,2) = c;
+	++r;
+      }
+    }
+  }
+  this->init();
+}
+
+template<class F>
+void MatMul<F>::loadbinary(string filename){
+  MappedScheme scheme(filename);
+  const BexpHeader &header = *scheme.header;
+  if((int)header.n != n || (int)header.m != m || (int)header.l != l){
+    throw runtime_error("The shape stored in " + filename + " does not match the given dimensions");
+  }
+  const uint64_t* columns[3] = {scheme.column(0), scheme.column(1), scheme.column(2)};
+  loadcolumns(columns, header.rank, header.words, filename);
+}
+
+// Copies rank rows of factors with stored words each into data. Factors
+// written with another word width are widened or narrowed, as long as no
+// set bit is lost.
+template<class F>
+void MatMul<F>::loadcolumns(const uint64_t* const columns[3], int rank, int stored, string name){
+  if(rank > this->maxrank){
+    throw runtime_error("Rank of " + name + " exceeds the maximum rank");
+  }
+  this->rank = rank;
+  int words = sizeof(F)/8;
+  for(int k = 0; k < 3; ++k){
+    const uint64_t* from = columns[k];
+    uint64_t* to = (uint64_t*)&this->get(0,k);
+    if(stored == words){
+      memcpy(to, from, (size_t)rank*words*8);
+      continue;
+    }
+    for(int i = 0; i < rank; ++i){
+      for(int w = 0; w < words; ++w){
+	to[i*words+w] = w < stored ? from[i*stored+w] : 0;
+      }
+      for(int w = words; w < stored; ++w){
+	if(from[i*stored+w] != 0){
+	  throw runtime_error("Factors of " + name + " do not fit the word size");
+	}
+      }
+    }
+  }
+}
+
+namespace{
+  // Orders factors by their words, most significant first.
+  template<class F>
+  bool lessfactor(const F &x, const F &y){
+    const uint64_t* u = (const uint64_t*)&x;
+    const uint64_t* v = (const uint64_t*)&y;
+    for(int w = sizeof(F)/8 - 1; w >= 0; --w){
+      if(u[w] != v[w]){
+	return u[w] < v[w];
+      }
+    }
+    return false;
+  }
+
+  template<class F>
+  bool lessrow(const F* x, const F* y){
+    for(int k = 0; k < 3; ++k){
+      if(x[k] != y[k]){
+	return lessfactor(x[k], y[k]);
+      }
+    }
+    return false;
+  }
+}
+
+template<class F>
+vector<F> MatMul<F>::canonical() const {
+  int rank = this->rank;
+  const F* data = this->data;
+  int maxrank = this->maxrank;
+  vector<F> best;
+  vector<F> rows(3*rank);
+  vector<int> order(rank);
+  vector<F> image(3*rank);
+  for(int transpose = 0; transpose < 2; ++transpose){
+    for(int shift = 0; shift < 3; ++shift){
+      // Shape after shifting shift times and then transposing.
+      int dims[3] = {n, m, l};
+      int d[3] = {dims[shift], dims[(shift+1)%3], dims[(shift+2)%3]};
+      if(transpose){
+	swap(d[1], d[2]);
+      }
+      if(d[0] != n || d[1] != m || d[2] != l){
+	continue;
+      }
+      // Factor k of the shifted scheme is factor (shift+k)%3 of this one,
+      // which is a d[k] x d[k+1] matrix with the shifted dimensions.
+      int s[3] = {dims[shift], dims[(shift+1)%3], dims[(shift+2)%3]};
+      for(int i = 0; i < rank; ++i){
+	F x = data[((shift)%3)*maxrank+i];
+	F y = data[((shift+1)%3)*maxrank+i];
+	F z = data[((shift+2)%3)*maxrank+i];
+	if(transpose){
+	  rows[3*i] = transposem(z, s[2], s[0]);
+	  rows[3*i+1] = transposem(y, s[1], s[2]);
+	  rows[3*i+2] = transposem(x, s[0], s[1]);
+	}else{
+	  rows[3*i] = x;
+	  rows[3*i+1] = y;
+	  rows[3*i+2] = z;
+	}
+	order[i] = i;
+      }
+      sort(order.begin(), order.end(), [&](int r1, int r2){
+	  return lessrow(&rows[3*r1], &rows[3*r2]);
+	});
+      for(int i = 0; i < rank; ++i){
+	for(int k = 0; k < 3; ++k){
+	  image[k*rank+i] = rows[3*order[i]+k];
+	}
+      }
+      bool smaller = best.empty();
+      for(int i = 0; i < 3*rank && !smaller; ++i){
+	if(image[i] != best[i]){
+	  smaller = lessfactor(image[i], best[i]);
+	  break;
+	}
+      }
+      if(smaller){
+	best = image;
+      }
+    }
+  }
+  return best;
+}
+
+template<class F>
+bool MatMul<F>::appendto(Pool &pool, uint64_t &index){
+  const PoolHeader &header = pool.header;
+  if((int)header.n != n || (int)header.m != m || (int)header.l != l || (int)header.rank != this->rank || header.words != sizeof(F)/8){
+    throw runtime_error("The scheme does not fit the pool");
+  }
+  vector<F> form = canonical();
+  const uint64_t* columns[3];
+  for(int k = 0; k < 3; ++k){
+    columns[k] = (const uint64_t*)&form[k*this->rank];
+  }
+  return pool.append(columns, index);
 }
 
-MM::MM(const MM &t) : Tensor(t){
+template<class F>
+void MatMul<F>::savebinary(string filename){
+  BexpHeader header;
+  memcpy(header.magic, "BEXP", 4);
+  header.version = BEXP_VERSION;
+  header.n = n;
+  header.m = m;
+  header.l = l;
+  header.rank = this->rank;
+  header.words = sizeof(F)/8;
+  header.reserved = 0;
+  const uint64_t* columns[3];
+  for(int k = 0; k < 3; ++k){
+    columns[k] = (const uint64_t*)this->column(k);
+  }
+  writebinary(filename, header, columns);
+}
+
+template<class F>
+MatMul<F>::MatMul(const MatMul<F> &t) : Tensor<F>(t){
   n = t.n;
   m = t.m;
   l = t.l;
 }
 
-MM* MM::clone() const {
-  return new MM(*this);
+template<class F>
+MatMul<F>* MatMul<F>::clone() const {
+  return new MatMul<F>(*this);
 }
 
 
-void parseMatrix(string s, char x, int m, factor* matrix, bool isLargeFormat){
+template<class F>
+void parseMatrix(string s, char x, int m, F* matrix, bool isLargeFormat){
   *matrix = 0;
   int pos = -1;
   if(isLargeFormat){
@@ -79,40 +318,45 @@ void parseMatrix(string s, char x, int m, factor* matrix, bool isLargeFormat){
   }
 }
 
-void MM::write(string filename){
+template<class F>
+void MatMul<F>::write(string filename){
+  if(isbinary(filename)){
+    savebinary(filename);
+    return;
+  }
   //CHECK IF WE NEED TO WRITE BIG OR SMALL
   bool isLargeFormat = false;
   if(filename.length() > 5 && filename.substr(filename.length() - 5) == ".lexp"){
     isLargeFormat = true;
   }
   ofstream output(filename);
-  for(auto r=0; r<rank; ++r){
-    writeMatrix(output,'a',n,m,get(r,0),isLargeFormat);
+  writetext(output, isLargeFormat);
+  output.close();
+}
+
+template<class F>
+void MatMul<F>::writetext(ostream &output, bool isLargeFormat){
+  for(auto r=0; r<this->rank; ++r){
+    writeMatrix(output,'a',n,m,this->get(r,0),isLargeFormat);
     output << '*';
-    writeMatrix(output,'b',m,l,get(r,1),isLargeFormat);
+    writeMatrix(output,'b',m,l,this->get(r,1),isLargeFormat);
     output << '*';
-    writeMatrix(output,'c',l,n,get(r,2),isLargeFormat);
+    writeMatrix(output,'c',l,n,this->get(r,2),isLargeFormat);
     output << endl;
   }
-  output.close();
 }
 
-void MM::writetoconsole(){
+template<class F>
+void MatMul<F>::writetoconsole(){
   bool isLargeFormat = (n > 9 || m > 9 || l > 9);
   ostringstream output;
-  for(auto r=0; r<rank; ++r){
-    writeMatrix(output,'a',n,m,get(r,0),isLargeFormat);
-    output << '*';
-    writeMatrix(output,'b',m,l,get(r,1),isLargeFormat);
-    output << '*';
-    writeMatrix(output,'c',l,n,get(r,2),isLargeFormat);
-    output << endl;
-  }
+  writetext(output, isLargeFormat);
   output << endl;
   cout << output.str();
 }
 
-void writeMatrix(ostream &output, char x, int n, int m, factor matrix, bool isLargeFormat){
+template<class F>
+void writeMatrix(ostream &output, char x, int n, int m, F matrix, bool isLargeFormat){
   output << '(';
   if(isLargeFormat){
     for(int i = 1; i <= n; ++i){
@@ -139,46 +383,137 @@ void writeMatrix(ostream &output, char x, int n, int m, factor matrix, bool isLa
   output << ')';
 }
 
-//Test whether a scheme is a correct matrix multiplication scheme
-bool MM::iscorrect(){
-  if(correctness_check==0){
-    return true;
-  }
-  factor** t = new factor*[64];
-  for(int i = 0; i < n*m; ++i){
-    t[i] = new factor[64];
-    for(int j = 0; j < m*l; ++j){
-      t[i][j] = 0;
+namespace{
+  // Writes the positions of the set bits of x to bits; returns how many.
+  template<class F>
+  int setbits(const F &x, int* bits){
+    const uint64_t* words = (const uint64_t*)&x;
+    int count = 0;
+    for(int w = 0; w < (int)(sizeof(F)/8); ++w){
+      for(uint64_t v = words[w]; v != 0; v &= v - 1){
+	bits[count++] = 64*w + __builtin_ctzll(v);
+      }
     }
+    return count;
   }
-  
+}
+
+// The tensor is kept as an (nm) x (ml) table of c factors. It starts as
+// the matrix multiplication tensor and every row (a,b,c) of the scheme
+// adds c at the set bits of a times the set bits of b, so the scheme is
+// correct exactly when the table ends up zero.
+template<class F>
+bool checkscheme(const F* a, const F* b, const F* c, int rank, int n, int m, int l, vector<F> &buffer){
+  int width = m*l;
+  buffer.assign((size_t)n*m*width, (F)0);
+  F* t = buffer.data();
   for(int i = 0; i < n; ++i){
     for(int j = 0; j < m; ++j){
       for(int k = 0; k < l; ++k){
-	t[m*i+j][l*j+k] = (factor)1 << (n*k+i);
+	t[(m*i+j)*width + l*j+k] = (F)1 << (n*k+i);
       }
     }
   }
-  
+
+  int abits[8*sizeof(F)];
+  int bbits[8*sizeof(F)];
   for(int s = 0; s < rank; ++s){
-    for(int i = 0; i < n*m; ++i){
-      for(int j = 0; j < m*l; ++j){
-	if(get(s,0)&(factor)1<<i && get(s,1)&(factor)1<<j){
-	  t[i][j] ^= get(s,2);
-	}
+    int acount = setbits(a[s], abits);
+    int bcount = setbits(b[s], bbits);
+    const F z = c[s];
+    for(int x = 0; x < acount; ++x){
+      F* row = t + abits[x]*width;
+      for(int y = 0; y < bcount; ++y){
+	row[bbits[y]] ^= z;
       }
     }
   }
-  
-  for(int i = 0; i < n*m; ++i){
-    for(int j = 0; j < m*l; ++j){
-      if(t[i][j] != 0){
-	return false;
+
+  const uint64_t* words = (const uint64_t*)t;
+  uint64_t any = 0;
+  for(size_t w = 0; w < buffer.size()*(sizeof(F)/8); ++w){
+    any |= words[w];
+  }
+  return any == 0;
+}
+
+// Each round draws 64 pairs of random matrices A (n x m) and B (m x l),
+// bit t of every entry belonging to pair t, and runs the scheme on all of
+// them at once: row s adds (sum of A at a's bits)(sum of B at b's bits) to
+// the entries of the product at c's bits. The product of the scheme is
+// then compared with the naive product, stored transposed like c.
+template<class F>
+bool probablycorrect(const F* a, const F* b, const F* c, int rank, int n, int m, int l, int rounds, Rng &gen, vector<uint64_t> &buffer){
+  buffer.resize(n*m + m*l + l*n);
+  uint64_t* A = buffer.data();
+  uint64_t* B = A + n*m;
+  uint64_t* C = B + m*l;
+  int bits[8*sizeof(F)];
+  for(int round = 0; round < rounds; ++round){
+    for(int i = 0; i < n*m + m*l; ++i){
+      A[i] = gen();
+    }
+    for(int i = 0; i < l*n; ++i){
+      C[i] = 0;
+    }
+    for(int s = 0; s < rank; ++s){
+      uint64_t alpha = 0;
+      int count = setbits(a[s], bits);
+      for(int x = 0; x < count; ++x){
+	alpha ^= A[bits[x]];
+      }
+      if(alpha == 0){
+	continue;
+      }
+      uint64_t beta = 0;
+      count = setbits(b[s], bits);
+      for(int x = 0; x < count; ++x){
+	beta ^= B[bits[x]];
+      }
+      uint64_t gamma = alpha & beta;
+      if(gamma == 0){
+	continue;
+      }
+      count = setbits(c[s], bits);
+      for(int x = 0; x < count; ++x){
+	C[bits[x]] ^= gamma;
+      }
+    }
+    for(int i = 0; i < n; ++i){
+      for(int k = 0; k < l; ++k){
+	uint64_t product = 0;
+	for(int j = 0; j < m; ++j){
+	  product ^= A[m*i+j] & B[l*j+k];
+	}
+	if(product != C[n*k+i]){
+	  return false;
+	}
       }
     }
-    delete[] t[i];
   }
-  delete[] t;
   return true;
 }
 
+//Test whether a scheme is a correct matrix multiplication scheme
+template<class F>
+bool MatMul<F>::iscorrect(){
+  if(correctness_check==0){
+    return true;
+  }
+  // A failed random round is confirmed by the exact check.
+  if(verify_rounds > 0 && probablycorrect(this->column(0), this->column(1), this->column(2), this->rank, n, m, l, verify_rounds, checkgen, probebuffer)){
+    return true;
+  }
+  return checkscheme(this->column(0), this->column(1), this->column(2), this->rank, n, m, l, checkbuffer);
+}
+
+template bool checkscheme(const factor*, const factor*, const factor*, int, int, int, int, vector<factor>&);
+template bool checkscheme(const factor_big*, const factor_big*, const factor_big*, int, int, int, int, vector<factor_big>&);
+template bool checkscheme(const factor_wide*, const factor_wide*, const factor_wide*, int, int, int, int, vector<factor_wide>&);
+template bool probablycorrect(const factor*, const factor*, const factor*, int, int, int, int, int, Rng&, vector<uint64_t>&);
+template bool probablycorrect(const factor_big*, const factor_big*, const factor_big*, int, int, int, int, int, Rng&, vector<uint64_t>&);
+template bool probablycorrect(const factor_wide*, const factor_wide*, const factor_wide*, int, int, int, int, int, Rng&, vector<uint64_t>&);
+
+template class MatMul<factor>;
+template class MatMul<factor_big>;
+template class MatMul<factor_wide>;
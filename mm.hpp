@@ -17,32 +17,136 @@ You should have received a copy of the GNU General Public License along with big
 #define mm_hpp___
 
 #include "tensor.hpp"
-
-#define getm(matrix,m,i,j) matrix&(((factor)1)<<(m*(i-1)+j-1))
-#define setm(matrix,m,i,j) matrix = matrix|(((factor)1)<<(m*(i-1)+j-1))
-#define unset(matrix,m,i,j) matrix = matrix&~(((factor)1)<<(m*(i-1)+j-1))
+#include "pool.hpp"
+
+// Entry (i,j), counted from 1, of a matrix with m columns stored in a factor.
+template<class F>
+inline bool getm(const F &matrix, int m, int i, int j){
+  return (matrix & (((F)1) << (m*(i-1)+j-1))) != 0;
+}
+
+template<class F>
+inline void setm(F &matrix, int m, int i, int j){
+  matrix = matrix | (((F)1) << (m*(i-1)+j-1));
+}
+
+template<class F>
+inline void unset(F &matrix, int m, int i, int j){
+  matrix = matrix & ~(((F)1) << (m*(i-1)+j-1));
+}
+
+// The transpose of a rows x cols matrix stored in a factor.
+template<class F>
+inline F transposem(const F &matrix, int rows, int cols){
+  F t = 0;
+  for(int i = 1; i <= rows; ++i){
+    for(int j = 1; j <= cols; ++j){
+      if(getm(matrix, cols, i, j)){
+	setm(t, rows, j, i);
+      }
+    }
+  }
+  return t;
+}
+
+// A rows x cols matrix stored in a factor as the top left corner of a
+// matrix with newcols columns: entry (i,j) moves from bit cols*(i-1)+j-1 to
+// bit newcols*(i-1)+j-1.
+template<class F>
+inline F embedm(const F &matrix, int rows, int cols, int newcols){
+  F e = 0;
+  for(int i = 1; i <= rows; ++i){
+    for(int j = 1; j <= cols; ++j){
+      if(getm(matrix, cols, i, j)){
+	setm(e, newcols, i, j);
+      }
+    }
+  }
+  return e;
+}
 
 extern int correctness_check;
+extern int verify_rounds;  // if positive, iscorrect tries probablycorrect first
 
-class MM: public Tensor{
+// A matrix multiplication scheme: a is n x m, b is m x l and c is l x n.
+template<class F>
+class MatMul: public Tensor<F>{
 public:
   int n;
   int m;
   int l;
 
-  MM(string filename, int n);
-  MM(string filename, int n, int m, int l);
-  MM(const MM &t);
-
-  virtual MM* clone() const;
+  // Reads a .exp, .lexp or .bexp file; throws runtime_error if a .bexp
+  // file is malformed or of a different shape.
+  MatMul(string filename, int n, int m, int l);
+  // Reads entry index of a pool; throws runtime_error if there is none.
+  MatMul(const Pool &pool, uint64_t index, int n, int m, int l);
+  // Reads rank rows given column by column as in a .bexp file, with words
+  // 64-bit words per factor; throws runtime_error if they do not fit.
+  MatMul(const uint64_t* const columns[3], int rank, int words, int n, int m, int l);
+  // The edge transition of Arai et al.: a scheme of shape oldn, oldm, oldl,
+  // given as by the constructor above, as a scheme of the shape n, m, l,
+  // which must be at least as large in every dimension. Its factors are
+  // embedded in the larger matrices and the rows (a_ij, b_jk, c_ki) are
+  // added for every i, j, k outside the old shape, adding
+  // n*m*l - oldn*oldm*oldl to the rank. Throws runtime_error if the scheme
+  // does not fit or the new rank would exceed n*m*l.
+  MatMul(const uint64_t* const columns[3], int rank, int words, int oldn, int oldm, int oldl, int n, int m, int l);
+  MatMul(const MatMul<F> &t);
+
+  virtual MatMul<F>* clone() const;
 
   virtual void write(string filename);
   virtual void writetoconsole();
+  // The rows as in a .exp file, or a .lexp file if isLargeFormat.
+  void writetext(ostream &output, bool isLargeFormat);
 
   virtual bool iscorrect();
+
+  // The least of the schemes equivalent to this one under the symmetries
+  // that keep the shape: reordering the rows, the cyclic shift
+  // (a,b,c) -> (b,c,a) if n = m = l, and the transposition
+  // (a,b,c) -> (c^T,b^T,a^T) and its combinations with the shift where
+  // they map the shape to itself. Returns 3*rank factors, column a then b
+  // then c, with the rows sorted. Equivalent schemes have the same
+  // canonical form.
+  vector<F> canonical() const;
+
+  // Appends the canonical form of the scheme to a pool of its rank unless it is already there
+  // and sets index to its entry; returns whether it was added.
+  bool appendto(Pool &pool, uint64_t &index);
+
+private:
+  vector<F> checkbuffer;  // table of iscorrect, kept between calls
+  vector<uint64_t> probebuffer;
+  Rng checkgen;
+
+  void setup(int n, int m, int l);
+  void loadbinary(string filename);
+  void loadcolumns(const uint64_t* const columns[3], int rank, int stored, string name);
+  void savebinary(string filename);
 };
 
-void parseMatrix(string s, char x, int m, factor* f, bool isLargeFormat);
-void writeMatrix(ostream &output, char x, int n, int m, factor f, bool isLargeFormat);
+typedef MatMul<factor> MM;
+typedef MatMul<factor_big> MM_big;
+typedef MatMul<factor_wide> MM_wide;
+
+// Whether the rows (a[s], b[s], c[s]), s < rank, form a correct scheme for
+// the product of an n x m and an m x l matrix. buffer is the work space and
+// can be reused between calls.
+template<class F>
+bool checkscheme(const F* a, const F* b, const F* c, int rank, int n, int m, int l, vector<F> &buffer);
+
+// Runs the scheme on rounds times 64 random pairs of matrices and compares
+// with their products. A correct scheme always passes; an incorrect one
+// fails each pair with probability at least 1/4, so it passes a round with
+// probability below 10^-7. buffer is the work space.
+template<class F>
+bool probablycorrect(const F* a, const F* b, const F* c, int rank, int n, int m, int l, int rounds, Rng &gen, vector<uint64_t> &buffer);
+
+template<class F>
+void parseMatrix(string s, char x, int m, F* f, bool isLargeFormat);
+template<class F>
+void writeMatrix(ostream &output, char x, int n, int m, F f, bool isLargeFormat);
 
 #endif
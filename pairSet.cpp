@@ -16,29 +16,53 @@ You should have received a copy of the GNU General Public License along with big
 
 void PairSet::insert(uint64_t first, uint64_t second){
   uint64_t elem = (first << 32) | second;
+  size_t top = (first > second ? first : second) + 1;
+  if(where.size() < top){
+    where.resize(top);
+  }
+  where[first].push_back(pairs.size());
+  where[second].push_back(pairs.size());
   pairs.push_back(elem);
 }
 
 void PairSet::remove(uint64_t first, uint64_t second){
-  uint64_t pair = (first << 32) | second;
-  uint64_t pair2 = (second << 32) | first;
-  for(size_t i = 0; i < pairs.size(); ++i){
-    if(pairs[i] == pair || pairs[i] == pair2){
-      pairs[i] = pairs.back();
-      pairs.pop_back();
+  if(first >= where.size() || second >= where.size()){
+    return;
+  }
+  for(auto i : where[first]){
+    if(this->first(i) == second || this->second(i) == second){
+      erase(i);
       return;
     }
   }
 }
 
 void PairSet::remove(uint64_t elem){
-  for(size_t i = 0; i < pairs.size(); ++i){
-    if(first(i) == elem || second(i) == elem) {
-      pairs[i] = pairs.back();
-      pairs.pop_back();
-      --i;
+  if(elem >= where.size()){
+    return;
+  }
+  while(!where[elem].empty()){
+    erase(where[elem].back());
+  }
+}
+
+// Renames row from to row to in every pair. Row to must have no pairs.
+void PairSet::relabel(uint64_t from, uint64_t to){
+  if(from >= where.size()){
+    return;
+  }
+  if(where.size() <= to){
+    where.resize(to + 1);
+  }
+  for(auto i : where[from]){
+    if(first(i) == from){
+      pairs[i] = (to << 32) | second(i);
+    }else{
+      pairs[i] = (first(i) << 32) | to;
     }
   }
+  where[to].swap(where[from]);
+  where[from].clear();
 }
 
 size_t PairSet::size(){
@@ -46,10 +70,11 @@ size_t PairSet::size(){
 }
 
 bool PairSet::contains(uint64_t first, uint64_t second){
-  uint64_t pair = (first << 32) + second;
-  uint64_t pair2 = (second << 32) + first;
-  for(auto i :pairs){
-    if(i == pair || i == pair2){
+  if(first >= where.size() || second >= where.size()){
+    return false;
+  }
+  for(auto i : where[first]){
+    if(this->first(i) == second || this->second(i) == second){
       return true;
     }
   }
@@ -57,17 +82,14 @@ bool PairSet::contains(uint64_t first, uint64_t second){
 }
 
 bool PairSet::contains(uint64_t pair){
-  uint64_t pair2 = (pair & 0xFFFFFFFF) | (pair >> 32);
-  for(auto i : pairs){
-    if(i == pair || i == pair2){
-      return true;
-    }
-  }
-  return false;
+  return contains(pair >> 32, pair & 0xFFFFFFFF);
 }
 
 void PairSet::clear(){
   pairs.clear();
+  for(auto &w : where){
+    w.clear();
+  }
 }
 
 uint64_t PairSet::first(size_t i){
@@ -77,3 +99,36 @@ uint64_t PairSet::first(size_t i){
 uint64_t PairSet::second(size_t i){
   return pairs[i] & 0xFFFFFFFF;
 }
+
+// Removes the pair at position i by moving the last pair into its place.
+void PairSet::erase(size_t i){
+  unlink(first(i), i);
+  unlink(second(i), i);
+  size_t last = pairs.size() - 1;
+  if(i != last){
+    pairs[i] = pairs[last];
+    relink(first(i), last, i);
+    relink(second(i), last, i);
+  }
+  pairs.pop_back();
+}
+
+void PairSet::unlink(uint64_t row, uint32_t pos){
+  vector<uint32_t> &w = where[row];
+  for(size_t j = 0; j < w.size(); ++j){
+    if(w[j] == pos){
+      w[j] = w.back();
+      w.pop_back();
+      return;
+    }
+  }
+}
+
+void PairSet::relink(uint64_t row, uint32_t from, uint32_t to){
+  for(auto &p : where[row]){
+    if(p == from){
+      p = to;
+      return;
+    }
+  }
+}
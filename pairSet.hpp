@@ -20,13 +20,18 @@ You should have received a copy of the GNU General Public License along with big
 
 using namespace std;
 
+// Unordered pairs of rows. The pairs live in one flat array so a uniformly
+// random pair is a single index; where[r] holds the positions of the pairs
+// that contain row r, so removing a row costs its degree, not a scan.
 class PairSet{
   public:
   vector<uint64_t> pairs;
+  vector<vector<uint32_t>> where;
 
   void insert(uint64_t first, uint64_t second);
   void remove(uint64_t first, uint64_t second);
   void remove(uint64_t elem);
+  void relabel(uint64_t from, uint64_t to);
   size_t size();
   void clear();
   uint64_t first(size_t i);
@@ -34,6 +39,11 @@ class PairSet{
 
   bool contains(uint64_t first, uint64_t second);
   bool contains(uint64_t pair);
+
+  private:
+  void erase(size_t i);
+  void unlink(uint64_t row, uint32_t pos);
+  void relink(uint64_t row, uint32_t from, uint32_t to);
 };
   
 #endif
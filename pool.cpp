@@ -0,0 +1,246 @@
+/***********************************************************************
+pool.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "pool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+  uint64_t hashwords(const uint64_t* words, size_t count){
+    uint64_t h = 0x243F6A8885A308D3ULL ^ count;
+    for(size_t i = 0; i < count; ++i){
+      h = (h ^ words[i]) * 0x9E3779B97F4A7C15ULL;
+      h ^= h >> 29;
+    }
+    return h;
+  }
+
+  bool readall(int fd, void* buffer, size_t length, off_t offset){
+    char* to = (char*)buffer;
+    while(length > 0){
+      ssize_t n = pread(fd, to, length, offset);
+      if(n == -1 && errno == EINTR){
+	continue;
+      }
+      if(n <= 0){
+	return false;
+      }
+      to += n;
+      length -= n;
+      offset += n;
+    }
+    return true;
+  }
+
+  bool writeall(int fd, const void* buffer, size_t length, off_t offset){
+    const char* from = (const char*)buffer;
+    while(length > 0){
+      ssize_t n = pwrite(fd, from, length, offset);
+      if(n == -1 && errno == EINTR){
+	continue;
+      }
+      if(n <= 0){
+	return false;
+      }
+      from += n;
+      length -= n;
+      offset += n;
+    }
+    return true;
+  }
+
+  // Holds an exclusive flock on fd while in scope.
+  class FileLock{
+    public:
+    int fd;
+    FileLock(int fd) : fd(fd) {
+      while(flock(fd, LOCK_EX) == -1 && errno == EINTR){}
+    }
+    ~FileLock(){
+      flock(fd, LOCK_UN);
+    }
+  };
+}
+
+bool ispool(const string &filename){
+  return filename.length() > 5 && filename.substr(filename.length() - 5) == ".pool";
+}
+
+string poolpath(const string &dir, const string &prefix, int rank){
+  return dir + "/" + prefix + to_string(rank) + ".pool";
+}
+
+bool splitpoolpath(const string &path, string &dir, string &prefix, int &rank){
+  if(!ispool(path)){
+    return false;
+  }
+  size_t slash = path.rfind('/');
+  dir = slash == string::npos ? "." : path.substr(0, slash);
+  string name = path.substr(slash == string::npos ? 0 : slash + 1);
+  name = name.substr(0, name.length() - 5);
+  size_t digits = name.length();
+  while(digits > 0 && isdigit(name[digits-1])){
+    --digits;
+  }
+  if(digits == name.length()){
+    return false;
+  }
+  prefix = name.substr(0, digits);
+  rank = stoi(name.substr(digits));
+  return true;
+}
+
+Pool::Pool(const string &path, bool writable) : path(path), fd(-1), writable(writable), record(0), scanned(0) {
+  open(writable ? O_RDWR : O_RDONLY);
+  if(!readall(fd, &header, sizeof(PoolHeader), 0) || memcmp(header.magic, "POOL", 4) != 0 || header.version != POOL_VERSION){
+    ::close(fd);
+    throw runtime_error("Not a pool file: " + path);
+  }
+  record = 8 + (size_t)3*header.rank*header.words*8;
+}
+
+Pool::Pool(const string &path, int n, int m, int l, int rank, int words) : path(path), fd(-1), writable(true), record(0), scanned(0) {
+  open(O_RDWR | O_CREAT);
+  FileLock guard(fd);
+  struct stat st;
+  fstat(fd, &st);
+  if(st.st_size == 0){
+    memset(&header, 0, sizeof(PoolHeader));
+    memcpy(header.magic, "POOL", 4);
+    header.version = POOL_VERSION;
+    header.n = n;
+    header.m = m;
+    header.l = l;
+    header.rank = rank;
+    header.words = words;
+    if(!writeall(fd, &header, sizeof(PoolHeader), 0)){
+      ::close(fd);
+      throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+    }
+  }else if(!readall(fd, &header, sizeof(PoolHeader), 0) || memcmp(header.magic, "POOL", 4) != 0 || header.version != POOL_VERSION){
+    ::close(fd);
+    throw runtime_error("Not a pool file: " + path);
+  }
+  if((int)header.n != n || (int)header.m != m || (int)header.l != l || (int)header.rank != rank || (int)header.words != words){
+    ::close(fd);
+    throw runtime_error("The pool " + path + " holds schemes of another shape, rank or word size");
+  }
+  record = 8 + (size_t)3*rank*words*8;
+}
+
+Pool::~Pool(){
+  ::close(fd);
+}
+
+void Pool::open(int flags){
+  fd = ::open(path.c_str(), flags, 0644);
+  if(fd == -1){
+    throw runtime_error("Cannot open " + path + ": " + strerror(errno));
+  }
+}
+
+uint64_t Pool::size() const {
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(PoolHeader)){
+    return 0;
+  }
+  return (st.st_size - sizeof(PoolHeader))/record;
+}
+
+bool Pool::read(uint64_t index, uint64_t* columns) const {
+  if(index >= size()){
+    return false;
+  }
+  vector<uint64_t> buffer(record/8);
+  if(!readall(fd, buffer.data(), record, sizeof(PoolHeader) + index*record)){
+    return false;
+  }
+  if(buffer[0] != hashwords(buffer.data() + 1, buffer.size() - 1)){
+    return false;
+  }
+  memcpy(columns, buffer.data() + 1, record - 8);
+  return true;
+}
+
+// Reads the keys of the entries other processes appended since the last call.
+void Pool::scan(uint64_t count){
+  for(; scanned < count; ++scanned){
+    uint64_t key;
+    if(readall(fd, &key, 8, sizeof(PoolHeader) + scanned*record)){
+      keys.insert(make_pair(key, scanned));
+    }
+  }
+}
+
+bool Pool::append(const uint64_t* const columns[3], uint64_t &index){
+  if(!writable){
+    throw runtime_error("The pool " + path + " is open read only");
+  }
+  int rank = header.rank;
+  int words = header.words;
+  vector<int> order(rank);
+  for(int i = 0; i < rank; ++i){
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [&](int r1, int r2){
+      for(int k = 0; k < 3; ++k){
+	for(int w = words - 1; w >= 0; --w){
+	  uint64_t x = columns[k][r1*words+w];
+	  uint64_t y = columns[k][r2*words+w];
+	  if(x != y){
+	    return x < y;
+	  }
+	}
+      }
+      return false;
+    });
+  vector<uint64_t> entry(record/8);
+  for(int k = 0; k < 3; ++k){
+    for(int i = 0; i < rank; ++i){
+      memcpy(&entry[1 + ((size_t)k*rank + i)*words], &columns[k][order[i]*words], words*8);
+    }
+  }
+  entry[0] = hashwords(entry.data() + 1, entry.size() - 1);
+
+  lock_guard<mutex> threads(lock);
+  FileLock processes(fd);
+  struct stat st;
+  fstat(fd, &st);
+  uint64_t count = (st.st_size - sizeof(PoolHeader))/record;
+  scan(count);
+  auto range = keys.equal_range(entry[0]);
+  vector<uint64_t> other(record/8);
+  for(auto it = range.first; it != range.second; ++it){
+    if(readall(fd, other.data(), record, sizeof(PoolHeader) + it->second*record) && other == entry){
+      index = it->second;
+      return false;
+    }
+  }
+  // A writer that died mid-record leaves a torn tail; the next entry
+  // overwrites it.
+  if(!writeall(fd, entry.data(), record, sizeof(PoolHeader) + count*record)){
+    throw runtime_error("Cannot write " + path + ": " + strerror(errno));
+  }
+  keys.insert(make_pair(entry[0], count));
+  scanned = count + 1;
+  index = count;
+  return true;
+}
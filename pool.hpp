@@ -0,0 +1,104 @@
+/***********************************************************************
+pool.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef pool_hpp__
+#define pool_hpp__
+
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+#include<vector>
+
+using namespace std;
+
+// A pool of schemes of one shape and rank in a single append-only file
+// (*.pool), replacing a directory with one file per scheme. After a 64 byte
+// header come fixed size records: a 64-bit key, then the a, b and c columns
+// of the scheme as in a .bexp file. Entry i is therefore found by its
+// offset alone.
+//
+// Rows are sorted before a scheme is appended, so the same scheme with its
+// rows in another order is stored once; MatMul::appendto goes further and
+// appends the canonical form, so schemes equivalent under symmetry are too.
+// The key is a hash of the stored record and is checked again on reading,
+// which catches a torn record.
+// Appending takes an exclusive flock and a mutex, so processes and threads
+// can append to and read from one pool at the same time. Readers take no
+// lock.
+struct PoolHeader{
+  char magic[4];       // "POOL"
+  uint32_t version;    // POOL_VERSION
+  uint32_t n;          // shape of the MatMul: a is n x m, b is m x l, c is l x n
+  uint32_t m;
+  uint32_t l;
+  uint32_t rank;
+  uint32_t words;      // 64-bit words per factor
+  uint32_t reserved[9];
+};
+
+static_assert(sizeof(PoolHeader) == 64, "PoolHeader must be 64 bytes");
+
+const uint32_t POOL_VERSION = 1;
+
+bool ispool(const string &filename);
+
+// Path of the pool of the given prefix and rank in dir, e.g. "dir/x23.pool".
+string poolpath(const string &dir, const string &prefix, int rank);
+
+// Splits a path made by poolpath into its parts; false if it is not one.
+bool splitpoolpath(const string &path, string &dir, string &prefix, int &rank);
+
+class Pool{
+  public:
+  PoolHeader header;
+
+  // Opens an existing pool, read only unless writable. Throws runtime_error
+  // if it is missing or malformed.
+  Pool(const string &path, bool writable = false);
+  // Opens the pool, creating it if it does not exist yet. Throws
+  // runtime_error if an existing pool has a different shape, rank or word
+  // size.
+  Pool(const string &path, int n, int m, int l, int rank, int words);
+  ~Pool();
+
+  // Number of complete entries; grows while others append.
+  uint64_t size() const;
+
+  // Copies entry index into columns (3*rank*words words, a, b and c one
+  // after the other). False if there is no such entry or it is torn.
+  bool read(uint64_t index, uint64_t* columns) const;
+
+  // Appends the scheme unless the pool already holds it. index is set to
+  // the position of the scheme either way. Returns whether it was added.
+  // Throws runtime_error if the write fails or the pool is read only.
+  bool append(const uint64_t* const columns[3], uint64_t &index);
+
+  private:
+  string path;
+  int fd;
+  bool writable;
+  size_t record;  // bytes per entry including the key
+  mutex lock;
+  uint64_t scanned;  // entries whose keys are in keys
+  unordered_multimap<uint64_t, uint64_t> keys;
+
+  void open(int flags);
+  void scan(uint64_t count);
+
+  Pool(const Pool&);
+  Pool& operator=(const Pool&);
+};
+
+#endif
@@ -0,0 +1,470 @@
+/***********************************************************************
+pooltool.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+// Moves schemes between the solutions/<l,m,n>/<prefix><rank>/ directory
+// layout and pool files. Build with "make pool":
+//   ./flip_pool import <shape dir> <prefix> <dim 1> <dim 2> <dim 3>
+//   ./flip_pool export <shape dir> <prefix> <dim 1> <dim 2> <dim 3> [.exp|.lexp|.bexp]
+//   ./flip_pool dedup <shape dir> <prefix> <dim 1> <dim 2> <dim 3>
+//   ./flip_pool verify <shape dir> <prefix> <dim 1> <dim 2> <dim 3>
+//   ./flip_pool expand <shape dir> <prefix> <dim 1> <dim 2> <dim 3> <new shape dir> <new dim 1> <new dim 2> <new dim 3>
+//   ./flip_pool info <pool>
+//   ./flip_pool shm-info <segment>
+//   ./flip_pool shm-save <segment> <shape dir> <prefix>
+//   ./flip_pool shm-remove <segment>
+// import adds every scheme in <shape dir>/<prefix><rank>/ to
+// <shape dir>/<prefix><rank>.pool; export writes every entry of those pools
+// back into the directories, one file per scheme. dedup rewrites the pools
+// keeping one scheme of each canonical form (see MatMul::canonical) and
+// dropping torn entries; it must not run while others append to them. verify checks every entry of
+// the pools with checkscheme on all cores and lists the incorrect ones.
+// expand takes the pool of lowest rank and adds the edge transition of every
+// entry (see MatMul) to the pool of the same prefix in <new shape dir>.
+// The shm commands work on the shared memory segments of flip --descend
+// --shm (see ShmPool): shm-save appends every entry of each rank to the
+// pool of that rank in <shape dir>, which is how a segment outlives a
+// reboot.
+
+# include "mm.hpp"
+# include "shmpool.hpp"
+# include <algorithm>
+# include <atomic>
+# include <stdexcept>
+# include <thread>
+# include <dirent.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+int oldrank;
+string filename;
+int correctness_check = 0;
+int verify_rounds = 0;
+volatile sig_atomic_t termination_flag = 0;
+
+namespace{
+  vector<string> entries(const string &dir){
+    vector<string> names;
+    DIR* d = opendir(dir.c_str());
+    if(d == NULL){
+      return names;
+    }
+    while(struct dirent* e = readdir(d)){
+      string name = e->d_name;
+      if(name != "." && name != ".."){
+	names.push_back(name);
+      }
+    }
+    closedir(d);
+    sort(names.begin(), names.end());
+    return names;
+  }
+
+  bool isdirectory(const string &path){
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+  }
+
+  // The rank in a name of the form <prefix><rank>, or -1.
+  int rankof(const string &name, const string &prefix){
+    if(name.length() <= prefix.length() || name.compare(0, prefix.length(), prefix) != 0){
+      return -1;
+    }
+    string digits = name.substr(prefix.length());
+    if(digits.find_first_not_of("0123456789") != string::npos){
+      return -1;
+    }
+    return stoi(digits);
+  }
+
+  template<class F>
+  int import(const string &dir, const string &prefix, int n, int m, int l){
+    for(const string &name : entries(dir)){
+      if(rankof(name, prefix) == -1 || !isdirectory(dir + "/" + name)){
+	continue;
+      }
+      uint64_t added = 0, duplicates = 0;
+      for(const string &file : entries(dir + "/" + name)){
+	MatMul<F> s(dir + "/" + name + "/" + file, n, m, l);
+	if(s.rank == 0){
+	  cerr << "Skipping " << dir << "/" << name << "/" << file << endl;
+	  continue;
+	}
+	Pool pool(poolpath(dir, prefix, s.rank), n, m, l, s.rank, sizeof(F)/8);
+	uint64_t index;
+	if(s.appendto(pool, index)){
+	  ++added;
+	}else{
+	  ++duplicates;
+	}
+      }
+      cout << dir << "/" << name << ": " << added << " added, " << duplicates << " duplicates" << endl;
+    }
+    return 0;
+  }
+
+  template<class F>
+  int dedup(const string &dir, const string &prefix, int n, int m, int l){
+    for(const string &name : entries(dir)){
+      if(!ispool(name) || rankof(name.substr(0, name.length() - 5), prefix) == -1){
+	continue;
+      }
+      string path = dir + "/" + name;
+      string rewritten = path + ".tmp";
+      unlink(rewritten.c_str());
+      Pool pool(path);
+      const PoolHeader &h = pool.header;
+      if((int)h.n != n || (int)h.m != m || (int)h.l != l){
+	throw runtime_error("The shape of " + path + " does not match the given dimensions");
+      }
+      uint64_t count = pool.size();
+      uint64_t kept = 0, torn = 0;
+      try{
+	Pool out(rewritten, n, m, l, h.rank, h.words);
+	vector<uint64_t> entry((size_t)3*h.rank*h.words);
+	const uint64_t* columns[3] = {&entry[0], &entry[(size_t)h.rank*h.words], &entry[(size_t)2*h.rank*h.words]};
+	for(uint64_t i = 0; i < count; ++i){
+	  // Torn entries, left by a crashed writer, are dropped as readers skip them
+	  if(!pool.read(i, entry.data())){
+	    ++torn;
+	    continue;
+	  }
+	  MatMul<F> s(columns, h.rank, h.words, n, m, l);
+	  uint64_t index;
+	  if(s.appendto(out, index)){
+	    ++kept;
+	  }
+	}
+      }catch(...){
+	unlink(rewritten.c_str());
+	throw;
+      }
+      if(rename(rewritten.c_str(), path.c_str()) != 0){
+	unlink(rewritten.c_str());
+	cerr << "Cannot replace " << path << endl;
+	return 1;
+      }
+      cout << path << ": kept " << kept << " of " << count;
+      if(torn > 0){
+	cout << ", dropped " << torn << " torn";
+      }
+      cout << endl;
+    }
+    return 0;
+  }
+
+  template<class F>
+  int verify(const string &dir, const string &prefix, int n, int m, int l){
+    int failed = 0;
+    for(const string &name : entries(dir)){
+      if(!ispool(name) || rankof(name.substr(0, name.length() - 5), prefix) == -1){
+	continue;
+      }
+      string path = dir + "/" + name;
+      Pool pool(path);
+      const PoolHeader &h = pool.header;
+      if((int)h.n != n || (int)h.m != m || (int)h.l != l || h.words != sizeof(F)/8){
+	cerr << path << " holds schemes of another shape or word size" << endl;
+	failed = 1;
+	continue;
+      }
+      uint64_t count = pool.size();
+      int rank = h.rank;
+      atomic<uint64_t> next(0);
+      vector<uint64_t> bad;
+      mutex lock;
+      vector<thread> threads;
+      for(unsigned t = 0; t < max(1u, thread::hardware_concurrency()); ++t){
+	threads.push_back(thread([&](){
+	      vector<F> columns(3*rank);
+	      vector<F> buffer;
+	      for(uint64_t i = next++; i < count; i = next++){
+		F* a = columns.data();
+		if(!pool.read(i, (uint64_t*)a) || !checkscheme(a, a + rank, a + 2*rank, rank, n, m, l, buffer)){
+		  lock_guard<mutex> guard(lock);
+		  bad.push_back(i);
+		}
+	      }
+	    }));
+      }
+      for(auto &th : threads){
+	th.join();
+      }
+      sort(bad.begin(), bad.end());
+      for(uint64_t i : bad){
+	cout << path << ":" << i << " is incorrect" << endl;
+      }
+      cout << path << ": " << count - bad.size() << " of " << count << " correct" << endl;
+      if(!bad.empty()){
+	failed = 1;
+      }
+    }
+    return failed;
+  }
+
+  template<class F>
+  int expand(const string &dir, const string &prefix, int oldn, int oldm, int oldl, const string &target, int n, int m, int l){
+    int lowest = -1;
+    for(const string &name : entries(dir)){
+      int rank = ispool(name) ? rankof(name.substr(0, name.length() - 5), prefix) : -1;
+      if(rank != -1 && (lowest == -1 || rank < lowest) && Pool(dir + "/" + name).size() > 0){
+	lowest = rank;
+      }
+    }
+    if(lowest == -1){
+      cerr << "No pool " << prefix << "<rank>.pool with schemes in " << dir << endl;
+      return 1;
+    }
+    string path = poolpath(dir, prefix, lowest);
+    Pool pool(path);
+    const PoolHeader &h = pool.header;
+    if((int)h.n != oldn || (int)h.m != oldm || (int)h.l != oldl){
+      cerr << path << " holds schemes of another shape" << endl;
+      return 1;
+    }
+    uint64_t count = pool.size();
+    int rank = lowest + n*m*l - oldn*oldm*oldl;
+    int words = h.words;
+
+    // The canonical forms of the expanded schemes, computed on all cores
+    // and appended in the order of the entries
+    vector<vector<F>> forms(count);
+    atomic<uint64_t> next(0);
+    atomic<int> failed(0);
+    vector<thread> threads;
+    for(unsigned t = 0; t < max(1u, thread::hardware_concurrency()); ++t){
+      threads.push_back(thread([&](){
+	    vector<uint64_t> entry((size_t)3*lowest*words);
+	    for(uint64_t i = next++; i < count; i = next++){
+	      const uint64_t* columns[3] = {entry.data(), entry.data() + (size_t)lowest*words, entry.data() + (size_t)2*lowest*words};
+	      if(!pool.read(i, entry.data())){
+		failed = 1;
+		continue;
+	      }
+	      try{
+		MatMul<F> s(columns, lowest, words, oldn, oldm, oldl, n, m, l);
+		forms[i] = s.canonical();
+	      }catch(const runtime_error &e){
+		failed = 1;
+	      }
+	    }
+	  }));
+    }
+    for(auto &th : threads){
+      th.join();
+    }
+    mkdir(target.c_str(), 0755);
+    string out = poolpath(target, prefix, rank);
+    Pool expanded(out, n, m, l, rank, sizeof(F)/8);
+    uint64_t added = 0;
+    for(uint64_t i = 0; i < count; ++i){
+      if(forms[i].empty()){
+	cerr << path << ":" << i << " could not be read or expanded" << endl;
+	continue;
+      }
+      const uint64_t* columns[3];
+      for(int k = 0; k < 3; ++k){
+	columns[k] = (const uint64_t*)&forms[i][k*rank];
+      }
+      uint64_t index;
+      if(expanded.append(columns, index)){
+	++added;
+      }
+    }
+    cout << path << ": " << added << " of " << count << " schemes expanded to " << out << endl;
+    return failed.load();
+  }
+
+  template<class F>
+  int exportpools(const string &dir, const string &prefix, int n, int m, int l, string extension){
+    for(const string &name : entries(dir)){
+      if(!ispool(name) || rankof(name.substr(0, name.length() - 5), prefix) == -1){
+	continue;
+      }
+      Pool pool(dir + "/" + name);
+      string target = dir + "/" + name.substr(0, name.length() - 5);
+      mkdir(target.c_str(), 0755);
+      uint64_t count = pool.size();
+      for(uint64_t i = 0; i < count; ++i){
+	MatMul<F> s(pool, i, n, m, l);
+	s.write(target + "/" + s.newfilename(extension));
+      }
+      cout << dir << "/" << name << ": " << count << " schemes written to " << target << endl;
+    }
+    return 0;
+  }
+}
+
+int main(int argc, char* argv[]){
+  string command = argc > 1 ? argv[1] : "";
+  if(command == "info" && argc == 3){
+    try{
+      Pool pool(argv[2]);
+      const PoolHeader &h = pool.header;
+      cout << "shape " << h.l << "," << h.m << "," << h.n << " rank " << h.rank << " words " << h.words << " entries " << pool.size() << endl;
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if(command == "shm-info" && argc == 3){
+    try{
+      ShmPool shm(argv[2]);
+      const ShmHeader &h = *shm.header;
+      cout << "shape " << h.l << "," << h.m << "," << h.n << " words " << h.words << " bytes " << h.used.load() << " of " << h.size << endl;
+      for(uint32_t r = 0; r <= h.maxrank; ++r){
+	if(shm.size(r) > 0){
+	  cout << "rank " << r << " entries " << shm.size(r) << endl;
+	}
+      }
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if(command == "shm-save" && argc == 5){
+    try{
+      ShmPool shm(argv[2]);
+      const ShmHeader &h = *shm.header;
+      for(uint32_t r = 0; r <= h.maxrank; ++r){
+	uint64_t count = shm.size(r);
+	if(count == 0){
+	  continue;
+	}
+	string path = poolpath(argv[3], argv[4], r);
+	Pool pool(path, h.n, h.m, h.l, r, h.words);
+	vector<uint64_t> entry((size_t)3*r*h.words);
+	const uint64_t* columns[3] = {&entry[0], &entry[(size_t)r*h.words], &entry[(size_t)2*r*h.words]};
+	uint64_t added = 0, index;
+	for(uint64_t i = 0; i < count; ++i){
+	  if(shm.read(r, i, entry.data()) && pool.append(columns, index)){
+	    ++added;
+	  }
+	}
+	cout << path << ": " << added << " of " << count << " schemes added" << endl;
+      }
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if(command == "shm-remove" && argc == 3){
+    try{
+      ShmPool::remove(argv[2]);
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if(command == "expand" && argc == 11){
+    string dir = argv[2], prefix = argv[3], target = argv[7];
+    int oldl = strtol(argv[4], NULL, 10), oldm = strtol(argv[5], NULL, 10), oldn = strtol(argv[6], NULL, 10);
+    int l = strtol(argv[8], NULL, 10), m = strtol(argv[9], NULL, 10), n = strtol(argv[10], NULL, 10);
+    if(l < oldl || m < oldm || n < oldn){
+      cerr << "The new shape must contain the old one." << endl;
+      return 1;
+    }
+    if(l*m > 256 || m*n > 256 || n*l > 256){
+      cerr << "Too big, all matrices must have dimension product most 256." << endl;
+      return 1;
+    }
+    bool isBig = (l*m > 64 || m*n > 64 || n*l > 64);
+    bool isWide = (l*m > 128 || m*n > 128 || n*l > 128);
+    try{
+      if(isWide){
+	return expand<factor_wide>(dir, prefix, oldn, oldm, oldl, target, n, m, l);
+      }
+      if(isBig){
+	return expand<factor_big>(dir, prefix, oldn, oldm, oldl, target, n, m, l);
+      }
+      return expand<factor>(dir, prefix, oldn, oldm, oldl, target, n, m, l);
+    }catch(const runtime_error &e){
+      cerr << e.what() << endl;
+      return 1;
+    }
+  }
+  if((command != "import" && command != "export" && command != "dedup" && command != "verify") || argc < 7 || argc > 8){
+    cerr << "Usage: " << endl;
+    cerr << argv[0] << " import <shape dir> <prefix> <dim 1> <dim 2> <dim 3>" << endl;
+    cerr << argv[0] << " export <shape dir> <prefix> <dim 1> <dim 2> <dim 3> [.exp|.lexp|.bexp]" << endl;
+    cerr << argv[0] << " dedup <shape dir> <prefix> <dim 1> <dim 2> <dim 3>" << endl;
+    cerr << argv[0] << " verify <shape dir> <prefix> <dim 1> <dim 2> <dim 3>" << endl;
+    cerr << argv[0] << " expand <shape dir> <prefix> <dim 1> <dim 2> <dim 3> <new shape dir> <new dim 1> <new dim 2> <new dim 3>" << endl;
+    cerr << argv[0] << " info <pool>" << endl;
+    cerr << argv[0] << " shm-info <segment>" << endl;
+    cerr << argv[0] << " shm-save <segment> <shape dir> <prefix>" << endl;
+    cerr << argv[0] << " shm-remove <segment>" << endl;
+    return 1;
+  }
+  string dir = argv[2];
+  string prefix = argv[3];
+  int l = strtol(argv[4], NULL, 10);
+  int m = strtol(argv[5], NULL, 10);
+  int n = strtol(argv[6], NULL, 10);
+  string extension = (n>9 || m>9 || l>9) ? ".lexp" : ".exp";
+  if(argc == 8){
+    extension = argv[7];
+  }
+
+  bool isBig = (l*m > 64 || m*n > 64 || n*l > 64);
+  bool isWide = (l*m > 128 || m*n > 128 || n*l > 128);
+  bool isTooBig = (l*m > 256 || m*n > 256 || n*l > 256);
+
+  if(isTooBig){
+    cerr << "Too big, all matrices must have dimension product most 256." << endl;
+    return 1;
+  }
+  try{
+    if(command == "import"){
+      if(isWide){
+	return import<factor_wide>(dir, prefix, n, m, l);
+      }
+      if(isBig){
+	return import<factor_big>(dir, prefix, n, m, l);
+      }
+      return import<factor>(dir, prefix, n, m, l);
+    }
+    if(command == "dedup"){
+      if(isWide){
+	return dedup<factor_wide>(dir, prefix, n, m, l);
+      }
+      if(isBig){
+	return dedup<factor_big>(dir, prefix, n, m, l);
+      }
+      return dedup<factor>(dir, prefix, n, m, l);
+    }
+    if(command == "verify"){
+      if(isWide){
+	return verify<factor_wide>(dir, prefix, n, m, l);
+      }
+      if(isBig){
+	return verify<factor_big>(dir, prefix, n, m, l);
+      }
+      return verify<factor>(dir, prefix, n, m, l);
+    }
+    if(isWide){
+      return exportpools<factor_wide>(dir, prefix, n, m, l, extension);
+    }
+    if(isBig){
+      return exportpools<factor_big>(dir, prefix, n, m, l, extension);
+    }
+    return exportpools<factor>(dir, prefix, n, m, l, extension);
+  }catch(const runtime_error &e){
+    cerr << e.what() << endl;
+    return 1;
+  }
+}
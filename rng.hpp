@@ -0,0 +1,115 @@
+/***********************************************************************
+rng.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef rng_hpp__
+#define rng_hpp__
+
+#include<cstdint>
+
+// xoshiro256** (Blackman and Vigna) with the helpers the walk needs. The
+// 256-bit state is filled from a 64-bit seed by splitmix64. jump() advances
+// by 2^128 outputs, so walker t of a run uses the seed's stream jumped t
+// times and no two walkers overlap. Also usable as a standard uniform
+// random bit generator.
+class Rng{
+  public:
+  typedef uint64_t result_type;
+
+  uint64_t s[4];
+  uint64_t bits;  // cached random bits for coin()
+  int nbits;
+
+  Rng(uint64_t seed = 0){
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed){
+    for(int i = 0; i < 4; ++i){
+      seed += 0x9E3779B97F4A7C15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      s[i] = z ^ (z >> 31);
+    }
+    bits = 0;
+    nbits = 0;
+  }
+
+  static constexpr uint64_t min(){ return 0; }
+  static constexpr uint64_t max(){ return UINT64_MAX; }
+
+  uint64_t operator()(){
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, n) by Lemire's multiply and reject; n must be positive.
+  uint64_t below(uint64_t n){
+    __uint128_t m = (__uint128_t)(*this)() * n;
+    uint64_t low = (uint64_t)m;
+    if(low < n){
+      uint64_t threshold = -n % n;
+      while(low < threshold){
+	m = (__uint128_t)(*this)() * n;
+	low = (uint64_t)m;
+      }
+    }
+    return m >> 64;
+  }
+
+  bool coin(){
+    if(nbits == 0){
+      bits = (*this)();
+      nbits = 64;
+    }
+    bool b = bits & 1;
+    bits >>= 1;
+    --nbits;
+    return b;
+  }
+
+  void jump(){
+    static const uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+    uint64_t t[4] = {0, 0, 0, 0};
+    for(int i = 0; i < 4; ++i){
+      for(int b = 0; b < 64; ++b){
+	if(JUMP[i] & (uint64_t)1 << b){
+	  for(int k = 0; k < 4; ++k){
+	    t[k] ^= s[k];
+	  }
+	}
+	(*this)();
+      }
+    }
+    for(int k = 0; k < 4; ++k){
+      s[k] = t[k];
+    }
+    bits = 0;
+    nbits = 0;
+  }
+
+  private:
+  static uint64_t rotl(uint64_t x, int k){
+    return (x << k) | (x >> (64 - k));
+  }
+};
+
+#endif
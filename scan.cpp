@@ -0,0 +1,144 @@
+/***********************************************************************
+scan.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace{
+  typedef void (*kernel)(const uint64_t*, int, int, const uint64_t*, uint64_t*);
+
+  void eqmask_scalar(const uint64_t* col, int words, int n, const uint64_t* value, uint64_t* mask){
+    for(int k = 0; k < (n + 63)/64; ++k){
+      mask[k] = 0;
+    }
+    for(int i = 0; i < n; ++i){
+      bool equal = true;
+      for(int w = 0; w < words; ++w){
+	equal &= (col[i*words + w] == value[w]);
+      }
+      mask[i/64] |= (uint64_t)equal << (i%64);
+    }
+  }
+
+#ifdef SCAN_X86
+  // SSE2 has no 64-bit compare, so lanes are equal when both 32-bit halves are.
+  void eqmask_sse2(const uint64_t* col, int words, int n, const uint64_t* value, uint64_t* mask){
+    // value is held in at most two registers
+    if(words > 4 || (words > 1 && words % 2 != 0)){
+      eqmask_scalar(col, words, n, value, mask);
+      return;
+    }
+    for(int k = 0; k < (n + 63)/64; ++k){
+      mask[k] = 0;
+    }
+    int i = 0;
+    if(words == 1){
+      __m128i v = _mm_set1_epi64x(value[0]);
+      for(; i + 2 <= n; i += 2){
+	__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(col + i)), v);
+	eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2,3,0,1)));
+	mask[i/64] |= (uint64_t)_mm_movemask_pd(_mm_castsi128_pd(eq)) << (i%64);
+      }
+    }else{
+      __m128i v[2];
+      for(int w = 0; w < words; w += 2){
+	v[w/2] = _mm_loadu_si128((const __m128i*)(value + w));
+      }
+      for(; i < n; ++i){
+	int all = 0xFFFF;
+	for(int w = 0; w < words; w += 2){
+	  all &= _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(col + i*words + w)), v[w/2]));
+	}
+	mask[i/64] |= (uint64_t)(all == 0xFFFF) << (i%64);
+      }
+    }
+    for(; i < n; ++i){
+      mask[i/64] |= (uint64_t)(col[i] == value[0]) << (i%64);
+    }
+  }
+
+  __attribute__((target("avx2")))
+  void eqmask_avx2(const uint64_t* col, int words, int n, const uint64_t* value, uint64_t* mask){
+    for(int k = 0; k < (n + 63)/64; ++k){
+      mask[k] = 0;
+    }
+    int i = 0;
+    if(words == 1){
+      __m256i v = _mm256_set1_epi64x(value[0]);
+      for(; i + 4 <= n; i += 4){
+	__m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(col + i)), v);
+	mask[i/64] |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << (i%64);
+      }
+      for(; i < n; ++i){
+	mask[i/64] |= (uint64_t)(col[i] == value[0]) << (i%64);
+      }
+    }else if(words == 2){
+      __m256i v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)value));
+      for(; i + 2 <= n; i += 2){
+	__m256i eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(col + 2*i)), v);
+	int bits = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+	uint64_t pair = ((bits & 3) == 3) | ((uint64_t)((bits & 12) == 12) << 1);
+	mask[i/64] |= pair << (i%64);
+      }
+      for(; i < n; ++i){
+	mask[i/64] |= (uint64_t)(col[2*i] == value[0] && col[2*i+1] == value[1]) << (i%64);
+      }
+    }else{
+      for(; i < n; ++i){
+	int equal = 1;
+	for(int w = 0; w < words; w += 4){
+	  __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(col + i*words + w)),
+				       _mm256_loadu_si256((const __m256i*)(value + w)));
+	  equal &= _mm256_testz_si256(x, x);
+	}
+	mask[i/64] |= (uint64_t)equal << (i%64);
+      }
+    }
+  }
+#endif
+
+  kernel pick(const char* &name){
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")){
+      name = "avx2";
+      return eqmask_avx2;
+    }
+    name = "sse2";
+    return eqmask_sse2;
+#else
+    name = "scalar";
+    return eqmask_scalar;
+#endif
+  }
+
+  const char* kernelname = "scalar";
+  const kernel chosen = pick(kernelname);
+}
+
+void eqmask(const uint64_t* col, int words, int n, const uint64_t* value, uint64_t* mask){
+  if(words % 4 != 0 && words > 2){
+    eqmask_scalar(col, words, n, value, mask);
+    return;
+  }
+  chosen(col, words, n, value, mask);
+}
+
+const char* eqmask_kernel(){
+  return kernelname;
+}
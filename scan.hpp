@@ -0,0 +1,34 @@
+/***********************************************************************
+scan.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef scan_hpp__
+#define scan_hpp__
+
+#include<cstdint>
+
+// Compares value against the first n entries of a column of factors, each
+// made of words 64-bit words, and sets bit i of mask (word i/64) when
+// entry i is equal. mask needs (n+63)/64 words. The AVX2, SSE2 or scalar
+// kernel is picked once from the CPU the program runs on.
+void eqmask(const uint64_t* col, int words, int n, const uint64_t* value, uint64_t* mask);
+
+// Name of the kernel eqmask uses: "avx2", "sse2" or "scalar".
+const char* eqmask_kernel();
+
+template<class F>
+inline void eqmask(const F* col, int n, const F &value, uint64_t* mask){
+  eqmask((const uint64_t*)col, sizeof(F)/8, n, (const uint64_t*)&value, mask);
+}
+
+#endif
@@ -0,0 +1,65 @@
+/***********************************************************************
+schemehash.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef schemehash_hpp__
+#define schemehash_hpp__
+
+#include<cstdint>
+#include<string>
+
+using namespace std;
+
+// 128-bit hash of one rank one term whose factors have words 64-bit words
+// each. The hash of a scheme is the sum of the hashes of its rows modulo
+// 2^128: it does not depend on the order of the rows, changing a row
+// updates it in O(1), and unlike a xor of the rows two equal rows do not
+// cancel. It only uses the words of the factors, so it is the same on every
+// machine and can name files.
+inline __uint128_t hashrow(const uint64_t* a, const uint64_t* b, const uint64_t* c, int words){
+  const uint64_t* factors[3] = {a, b, c};
+  uint64_t lo = 0x243F6A8885A308D3ULL;
+  uint64_t hi = 0x13198A2E03707344ULL;
+  for(int k = 0; k < 3; ++k){
+    for(int i = 0; i < words; ++i){
+      lo = (lo ^ factors[k][i]) * 0x9E3779B97F4A7C15ULL;
+      lo ^= lo >> 29;
+      hi = (hi ^ factors[k][i]) * 0xC2B2AE3D27D4EB4FULL;
+      hi ^= hi >> 32;
+    }
+  }
+  lo = (lo ^ lo >> 31) * 0xBF58476D1CE4E5B9ULL;
+  hi = (hi ^ hi >> 27) * 0x94D049BB133111EBULL;
+  return (__uint128_t)(hi ^ hi >> 31) << 64 | (lo ^ lo >> 30);
+}
+
+// Sum of hashrow over rank rows stored column by column, as in a .bexp file.
+inline __uint128_t hashscheme(const uint64_t* const columns[3], int rank, int words){
+  __uint128_t h = 0;
+  for(int r = 0; r < rank; ++r){
+    h += hashrow(columns[0] + (size_t)r*words, columns[1] + (size_t)r*words, columns[2] + (size_t)r*words, words);
+  }
+  return h;
+}
+
+// The hash as 32 hex digits.
+inline string hexhash(__uint128_t h){
+  static const char digits[] = "0123456789abcdef";
+  string s(32, '0');
+  for(int i = 31; i >= 0; --i, h >>= 4){
+    s[i] = digits[h & 15];
+  }
+  return s;
+}
+
+#endif
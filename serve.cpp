@@ -0,0 +1,126 @@
+/***********************************************************************
+serve.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#include "serve.hpp"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Waits up to a second for fd to become readable; false on a timeout.
+static bool waitfor(int fd){
+  pollfd p;
+  p.fd = fd;
+  p.events = POLLIN;
+  p.revents = 0;
+  return poll(&p, 1, 1000) > 0;
+}
+
+bool LineReader::next(string &line){
+  while(true){
+    size_t end = buffer.find('\n');
+    if(end != string::npos){
+      line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      if(!line.empty() && line.back() == '\r'){
+	line.pop_back();
+      }
+      return true;
+    }
+    if(termination_flag){
+      return false;
+    }
+    if(!waitfor(fd)){
+      continue;
+    }
+    char chunk[4096];
+    ssize_t got = read(fd, chunk, sizeof(chunk));
+    if(got < 0 && errno == EINTR){
+      continue;
+    }
+    if(got <= 0){
+      // A last line without an end of line
+      if(got == 0 && !buffer.empty()){
+	line.swap(buffer);
+	buffer.clear();
+	return true;
+      }
+      return false;
+    }
+    buffer.append(chunk, got);
+  }
+}
+
+bool writeall(int fd, const string &text){
+  size_t done = 0;
+  while(done < text.size()){
+    ssize_t wrote = write(fd, text.data() + done, text.size() - done);
+    if(wrote < 0 && errno == EINTR){
+      continue;
+    }
+    if(wrote <= 0){
+      return false;
+    }
+    done += wrote;
+  }
+  return true;
+}
+
+int listenon(const string &path){
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(path.size() >= sizeof(address.sun_path)){
+    throw runtime_error("Socket path too long: " + path);
+  }
+  strcpy(address.sun_path, path.c_str());
+  struct stat st;
+  if(lstat(path.c_str(), &st) == 0){
+    if(!S_ISSOCK(st.st_mode)){
+      throw runtime_error("Not a socket: " + path);
+    }
+    unlink(path.c_str());
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0){
+    throw runtime_error(string("Cannot create a socket: ") + strerror(errno));
+  }
+  if(bind(fd, (sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 16) != 0){
+    string reason = strerror(errno);
+    close(fd);
+    throw runtime_error("Cannot listen on " + path + ": " + reason);
+  }
+  return fd;
+}
+
+int acceptnext(int fd){
+  while(!termination_flag){
+    if(!waitfor(fd)){
+      continue;
+    }
+    int client = accept(fd, NULL, NULL);
+    if(client >= 0){
+      return client;
+    }
+    if(errno != EINTR && errno != ECONNABORTED){
+      return -1;
+    }
+  }
+  return -1;
+}
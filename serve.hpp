@@ -0,0 +1,54 @@
+/***********************************************************************
+serve.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#ifndef serve_hpp__
+#define serve_hpp__
+
+#include <csignal>
+#include <string>
+
+using namespace std;
+
+extern volatile sig_atomic_t termination_flag;  // set on SIGINT or SIGTERM
+
+// Reads lines from a file descriptor for flip --serve. Blocking reads are
+// replaced by polls of a second so that a signal ends the server even
+// while it waits for a client.
+class LineReader{
+  public:
+  LineReader(int fd) : fd(fd) {}
+
+  // The next line without its end of line; false at the end of the input,
+  // on an error or once termination_flag is set.
+  bool next(string &line);
+
+  private:
+  int fd;
+  string buffer;
+};
+
+// Writes all of text to fd; false if the other end has gone.
+bool writeall(int fd, const string &text);
+
+// A Unix stream socket listening on path. An old socket left at path by an
+// earlier server is replaced; any other file there is not. Throws
+// runtime_error on failure.
+int listenon(const string &path);
+
+// The next client of a socket from listenon, or -1 on an error or once
+// termination_flag is set.
+int acceptnext(int fd);
+
+#endif
@@ -0,0 +1,261 @@
+/***********************************************************************
+shmpool.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#include "shmpool.hpp"
+#include "schemehash.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+  string shmpath(const string &name){
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+  }
+
+  // Sleeps a millisecond at a time until ok() or 5 seconds have passed.
+  template<class Ok>
+  bool waitfor(Ok ok){
+    for(int i = 0; i < 5000; ++i){
+      if(ok()){
+	return true;
+      }
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return ok();
+  }
+}
+
+ShmPool::ShmPool(const string &name, int n, int m, int l, int words, uint64_t size) : name(name), header(NULL), base(NULL), length(0) {
+  open(name, true, n, m, l, words, size);
+}
+
+ShmPool::ShmPool(const string &name) : name(name), header(NULL), base(NULL), length(0) {
+  open(name, false, 0, 0, 0, 0, 0);
+}
+
+ShmPool::~ShmPool(){
+  if(base != NULL){
+    munmap(base, length);
+  }
+}
+
+void ShmPool::open(const string &name, bool create, int n, int m, int l, int words, uint64_t size){
+  string path = shmpath(name);
+  int fd = -1;
+  bool created = false;
+  if(create){
+    fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    created = fd != -1;
+    if(!created && errno != EEXIST){
+      throw runtime_error("Cannot create the shared memory segment " + name + ": " + strerror(errno));
+    }
+  }
+  if(fd == -1){
+    fd = shm_open(path.c_str(), O_RDWR, 0);
+    if(fd == -1){
+      throw runtime_error("Cannot open the shared memory segment " + name + ": " + strerror(errno));
+    }
+  }
+
+  uint32_t maxrank = n*m*l;
+  uint32_t keybits = 10;
+  uint64_t start = 0;
+  if(created){
+    while(((uint64_t)1 << keybits) < size/256){
+      ++keybits;
+    }
+    start = sizeof(ShmHeader) + (maxrank + 1)*sizeof(ShmRank) + (sizeof(ShmKey) << keybits);
+    bool fits = size >= start + ((uint64_t)1 << 20) && size < ((uint64_t)1 << 48);
+    if(!fits || ftruncate(fd, size) != 0){
+      string reason = !fits ? "too small or too large" : strerror(errno);
+      close(fd);
+      shm_unlink(path.c_str());
+      throw runtime_error("Cannot create the shared memory segment " + name + ": " + reason);
+    }
+  }
+  struct stat st;
+  // The creator may not have set the size yet
+  if(!waitfor([&](){ return fstat(fd, &st) == 0 && (uint64_t)st.st_size >= sizeof(ShmHeader); })){
+    close(fd);
+    throw runtime_error("The shared memory segment " + name + " was never set up; remove it with flip_pool shm-remove");
+  }
+  length = st.st_size;
+  void* mapped = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(mapped == MAP_FAILED){
+    throw runtime_error("Cannot map the shared memory segment " + name + ": " + strerror(errno));
+  }
+  base = (char*)mapped;
+  header = head();
+
+  ShmHeader* h = head();
+  if(created){
+    memcpy(h->magic, "SHMP", 4);
+    h->version = SHM_VERSION;
+    h->n = n;
+    h->m = m;
+    h->l = l;
+    h->words = words;
+    h->maxrank = maxrank;
+    h->keybits = keybits;
+    h->size = size;
+    h->used.store((start + 63) & ~(uint64_t)63);
+    h->ready.store(SHM_READY, memory_order_release);
+    return;
+  }
+  if(!waitfor([&](){ return h->ready.load(memory_order_acquire) == SHM_READY; })){
+    throw runtime_error("The shared memory segment " + name + " was never set up; remove it with flip_pool shm-remove");
+  }
+  if(memcmp(h->magic, "SHMP", 4) != 0 || h->version != SHM_VERSION || h->size != length){
+    throw runtime_error("Not a segment of schemes: " + name);
+  }
+  if(create && ((int)h->n != n || (int)h->m != m || (int)h->l != l || (int)h->words != words)){
+    throw runtime_error("The shared memory segment " + name + " holds schemes of another shape or word size");
+  }
+}
+
+uint64_t ShmPool::allocate(uint64_t bytes){
+  bytes = (bytes + 63) & ~(uint64_t)63;
+  uint64_t offset = head()->used.fetch_add(bytes);
+  if(offset + bytes > header->size){
+    throw runtime_error("The shared memory segment " + name + " is full");
+  }
+  return offset;
+}
+
+atomic<uint64_t>* ShmPool::slot(int rank, uint64_t index, bool create){
+  uint64_t q = index/SHM_CHUNK + 1;
+  int c = 63 - __builtin_clzll(q);
+  uint64_t first = SHM_CHUNK*(((uint64_t)1 << c) - 1);
+  atomic<uint64_t> &pointer = rankinfo(rank)->chunks[c];
+  uint64_t chunk = pointer.load(memory_order_acquire);
+  if(chunk == 0){
+    if(!create){
+      return NULL;
+    }
+    // Space lost to a race here is one chunk
+    uint64_t fresh = allocate((SHM_CHUNK << c)*8);
+    if(pointer.compare_exchange_strong(chunk, fresh)){
+      chunk = fresh;
+    }
+  }
+  return (atomic<uint64_t>*)(base + chunk) + (index - first);
+}
+
+uint64_t ShmPool::size(int rank) const {
+  if(rank < 0 || rank > (int)header->maxrank){
+    return 0;
+  }
+  return rankinfo(rank)->count.load(memory_order_acquire);
+}
+
+bool ShmPool::read(int rank, uint64_t index, uint64_t* columns) const {
+  if(index >= size(rank)){
+    return false;
+  }
+  atomic<uint64_t>* s = const_cast<ShmPool*>(this)->slot(rank, index, false);
+  uint64_t offset = s == NULL ? 0 : s->load(memory_order_acquire);
+  if(offset == 0){
+    return false;
+  }
+  memcpy(columns, base + offset, (size_t)3*rank*header->words*8);
+  return true;
+}
+
+bool ShmPool::sample(int rank, Rng &gen, uint64_t* columns) const {
+  uint64_t count = size(rank);
+  for(int tries = 0; count > 0 && tries < 16; ++tries){
+    if(read(rank, gen.below(count), columns)){
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether record, as stored in a ShmKey, is the scheme of rank rows in
+// columns.
+bool ShmPool::holds(uint64_t record, int rank, const uint64_t* const columns[3]) const {
+  if((int)(record >> 48) != rank){
+    return false;
+  }
+  const char* stored = base + (record & (((uint64_t)1 << 48) - 1));
+  size_t bytes = (size_t)rank*header->words*8;
+  for(int k = 0; k < 3; ++k){
+    if(memcmp(stored + k*bytes, columns[k], bytes) != 0){
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ShmPool::append(int rank, const uint64_t* const columns[3], uint64_t &index){
+  if(rank < 0 || rank > (int)header->maxrank){
+    throw runtime_error("Rank out of the range of the shared memory segment " + name);
+  }
+  size_t words = (size_t)rank*header->words;
+  __uint128_t h = hashscheme(columns, rank, header->words);
+  uint64_t key = (uint64_t)h ^ (uint64_t)(h >> 64);
+  key += key == 0;
+
+  // Duplicates, the common case, are turned away before taking any space
+  ShmKey* table = keys();
+  uint64_t mask = ((uint64_t)1 << header->keybits) - 1;
+  uint64_t start = key & mask;
+  for(uint64_t probes = 0, i = start; probes <= mask; ++probes, i = (i + 1) & mask){
+    uint64_t record = table[i].record.load(memory_order_acquire);
+    if(record == 0){
+      break;
+    }
+    uint64_t k = table[i].key.load(memory_order_acquire);
+    if((k == key || k == 0) && holds(record, rank, columns)){
+      return false;
+    }
+  }
+
+  uint64_t offset = allocate(3*words*8);
+  for(int k = 0; k < 3; ++k){
+    memcpy(base + offset + k*words*8, columns[k], words*8);
+  }
+  uint64_t mine = offset | (uint64_t)rank << 48;
+  for(uint64_t probes = 0, i = start; ; ++probes, i = (i + 1) & mask){
+    if(probes > mask){
+      throw runtime_error("The key table of the shared memory segment " + name + " is full");
+    }
+    uint64_t record = 0;
+    if(table[i].record.compare_exchange_strong(record, mine)){
+      table[i].key.store(key, memory_order_release);
+      break;
+    }
+    uint64_t k = table[i].key.load(memory_order_acquire);
+    if((k == key || k == 0) && holds(record, rank, columns)){
+      return false;  // added by another process meanwhile; the record is lost
+    }
+  }
+  index = rankinfo(rank)->count.fetch_add(1);
+  slot(rank, index, true)->store(offset, memory_order_release);
+  return true;
+}
+
+void ShmPool::remove(const string &name){
+  if(shm_unlink(shmpath(name).c_str()) != 0){
+    throw runtime_error("Cannot remove the shared memory segment " + name + ": " + strerror(errno));
+  }
+}
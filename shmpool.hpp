@@ -0,0 +1,131 @@
+/***********************************************************************
+shmpool.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+
+#ifndef shmpool_hpp__
+#define shmpool_hpp__
+
+#include "rng.hpp"
+#include<atomic>
+#include<cstdint>
+#include<string>
+
+using namespace std;
+
+// Schemes of one shape and every rank in a POSIX shared memory segment, so
+// that the flip processes of one machine draw seeds from and publish
+// reductions to each other without files. The segment is
+//   ShmHeader, ShmRank for ranks 0 to maxrank, the key table, then records
+// where a record is a scheme as 3*rank factors of words 64-bit words,
+// column a, b, then c, and records and index chunks are handed out from
+// the end of what is used by an atomic add. Nothing is ever freed; a full
+// segment refuses further schemes.
+//
+// Each rank indexes its records by an array of offsets in chunks of
+// SHM_CHUNK << c slots. The key table, which keeps one copy of each scheme,
+// maps a 64-bit hash of the scheme to its rank and record. An append first
+// looks for the scheme, then writes its record, claims an empty ShmKey by
+// storing the record there, adds the hash, then claims an index and stores
+// the offset there, each with release order. A ShmKey only counts as a
+// duplicate once its record compares equal, so schemes whose hashes collide
+// are both kept; the hash only skips that comparison. Readers load with
+// acquire order and skip empty slots. All of it is lock-free and nothing
+// waits, and a process dying halfway leaves at worst an empty slot, an
+// unused record, a ShmKey without its hash or a scheme that is never
+// indexed.
+//
+// Whoever creates the segment fills in the header and sets ready last;
+// others wait for it, so a segment whose creator died while setting it up
+// is reported instead of used. Appends and reads only use the header's
+// atomics.
+struct ShmHeader{
+  char magic[4];        // "SHMP"
+  uint32_t version;     // SHM_VERSION
+  uint32_t n;           // shape of the MatMul: a is n x m, b is m x l, c is l x n
+  uint32_t m;
+  uint32_t l;
+  uint32_t words;       // 64-bit words per factor
+  uint32_t maxrank;
+  uint32_t keybits;     // log2 of the slots of the key table
+  uint64_t size;        // bytes of the segment
+  atomic<uint64_t> used;    // bytes handed out
+  atomic<uint32_t> ready;   // SHM_READY once the header is filled in
+  uint32_t reserved[19];
+};
+
+struct ShmKey{
+  atomic<uint64_t> record;  // offset of the record | rank << 48, 0 if the entry is free
+  atomic<uint64_t> key;     // hash of the scheme, 0 until added
+};
+
+struct ShmRank{
+  atomic<uint64_t> count;  // indices claimed
+  atomic<uint64_t> chunks[40];  // offsets of the index chunks, 0 until allocated
+};
+
+static_assert(sizeof(ShmHeader) == 128, "ShmHeader must be 128 bytes");
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Shared memory needs lock-free atomics");
+
+const uint32_t SHM_VERSION = 3;
+const uint32_t SHM_READY = 0x52454459;
+const uint64_t SHM_CHUNK = 64;
+
+class ShmPool{
+  public:
+  string name;
+  const ShmHeader* header;
+
+  // Opens the segment name, creating it with size bytes if it does not
+  // exist. Throws runtime_error if it cannot, if it is of another shape or
+  // word size, or if it is never made ready.
+  ShmPool(const string &name, int n, int m, int l, int words, uint64_t size);
+  // Opens an existing segment. Throws runtime_error as above.
+  ShmPool(const string &name);
+  ~ShmPool();
+
+  // Indices claimed at rank; some may not be filled in yet.
+  uint64_t size(int rank) const;
+
+  // Copies entry index of rank into columns (3*rank*words words); false if
+  // it is not filled in.
+  bool read(int rank, uint64_t index, uint64_t* columns) const;
+
+  // Copies a random entry of rank into columns; false if none is found.
+  bool sample(int rank, Rng &gen, uint64_t* columns) const;
+
+  // Appends the scheme of rank rows unless the segment already holds it.
+  // Returns whether it was added, and
+  // its index at rank if so. Throws runtime_error if the segment is full.
+  bool append(int rank, const uint64_t* const columns[3], uint64_t &index);
+
+  // Removes the segment name; those who have it open keep it.
+  static void remove(const string &name);
+
+  private:
+  char* base;
+  uint64_t length;
+
+  ShmHeader* head() const { return (ShmHeader*)base; }
+  ShmRank* rankinfo(int rank) const { return (ShmRank*)(base + sizeof(ShmHeader)) + rank; }
+  ShmKey* keys() const { return (ShmKey*)rankinfo(header->maxrank + 1); }
+  uint64_t allocate(uint64_t bytes);
+  bool holds(uint64_t record, int rank, const uint64_t* const columns[3]) const;
+  atomic<uint64_t>* slot(int rank, uint64_t index, bool create);
+  void open(const string &name, bool create, int n, int m, int l, int words, uint64_t size);
+
+  ShmPool(const ShmPool&);
+  ShmPool& operator=(const ShmPool&);
+};
+
+#endif
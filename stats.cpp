@@ -0,0 +1,122 @@
+/***********************************************************************
+stats.cpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#include "stats.hpp"
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+WalkStats::WalkStats() : flips(0), reduce_calls(0), reductions(0), splits(0), init_calls(0), init_ns(0), flip_ns(0), rank(0) {
+  for(int k = 0; k < 3; ++k){
+    pairs[k] = 0;
+  }
+}
+
+bool stats_enabled(){
+#ifdef FLIP_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+namespace{
+  void writeone(ostream &output, uint64_t flips, uint64_t reduce_calls, uint64_t reductions, uint64_t splits,
+		uint64_t init_calls, uint64_t init_ns, uint64_t flip_ns, const uint64_t* pairs, double seconds){
+    output << "\"flips\": " << flips
+	   << ", \"flips_per_sec\": " << (seconds > 0 ? flips / seconds : 0)
+	   << ", \"reduce_calls\": " << reduce_calls
+	   << ", \"reductions\": " << reductions
+	   << ", \"splits\": " << splits
+	   << ", \"pairs\": [" << pairs[0] << ", " << pairs[1] << ", " << pairs[2] << "]"
+	   << ", \"init_calls\": " << init_calls
+	   << ", \"init_sec\": " << init_ns * 1e-9
+	   << ", \"flip_sec\": " << flip_ns * 1e-9;
+  }
+}
+
+void writestats(ostream &output, const vector<WalkStats*> &walkers, double seconds){
+  uint64_t total[7] = {0, 0, 0, 0, 0, 0, 0};
+  uint64_t totalpairs[3] = {0, 0, 0};
+  stringstream each;
+  each << fixed << setprecision(3);
+  for(size_t w = 0; w < walkers.size(); ++w){
+    WalkStats* s = walkers[w];
+    uint64_t v[7] = {s->flips.load(), s->reduce_calls.load(), s->reductions.load(), s->splits.load(),
+		     s->init_calls.load(), s->init_ns.load(), s->flip_ns.load()};
+    uint64_t pairs[3] = {s->pairs[0].load(), s->pairs[1].load(), s->pairs[2].load()};
+    for(int i = 0; i < 7; ++i){
+      total[i] += v[i];
+    }
+    for(int k = 0; k < 3; ++k){
+      totalpairs[k] += pairs[k];
+    }
+    each << (w == 0 ? "" : ", ") << "{\"walker\": " << w << ", \"rank\": " << s->rank.load() << ", ";
+    writeone(each, v[0], v[1], v[2], v[3], v[4], v[5], v[6], pairs, seconds);
+    each << "}";
+  }
+  output << fixed << setprecision(3) << "{\"time\": " << seconds << ", ";
+  writeone(output, total[0], total[1], total[2], total[3], total[4], total[5], total[6], totalpairs, seconds);
+  output << ", \"walkers\": [" << each.str() << "]}" << endl;
+}
+
+StatsReporter::StatsReporter(const vector<WalkStats*> &walkers, double interval, string path)
+  : walkers(walkers), interval(interval), path(path), start(chrono::steady_clock::now()), stopped(false) {
+  if(interval > 0){
+    worker = thread(&StatsReporter::run, this);
+  }
+}
+
+StatsReporter::~StatsReporter(){
+  stop();
+}
+
+void StatsReporter::stop(){
+  {
+    lock_guard<mutex> guard(lock);
+    if(stopped){
+      return;
+    }
+    stopped = true;
+  }
+  wake.notify_all();
+  if(worker.joinable()){
+    worker.join();
+  }
+  report();
+}
+
+void StatsReporter::report(){
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if(path.empty()){
+    stringstream line;
+    writestats(line, walkers, seconds);
+    cerr << line.str();
+  }else{
+    ofstream output(path, ios_base::app);
+    writestats(output, walkers, seconds);
+  }
+}
+
+void StatsReporter::run(){
+  unique_lock<mutex> guard(lock);
+  while(!stopped){
+    if(wake.wait_for(guard, chrono::duration<double>(interval)) == cv_status::timeout && !stopped){
+      guard.unlock();
+      report();
+      guard.lock();
+    }
+  }
+}
@@ -0,0 +1,109 @@
+/***********************************************************************
+stats.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef stats_hpp__
+#define stats_hpp__
+
+#include<atomic>
+#include<chrono>
+#include<condition_variable>
+#include<cstdint>
+#include<mutex>
+#include<ostream>
+#include<string>
+#include<thread>
+#include<vector>
+
+using namespace std;
+
+// Counters of one walker. Only the walker writes them; a reporter thread
+// may read them at any time, hence the relaxed atomics.
+struct WalkStats{
+  atomic<uint64_t> flips;
+  atomic<uint64_t> reduce_calls;  // calls of reduce()
+  atomic<uint64_t> reductions;    // calls of reduce() that removed a row
+  atomic<uint64_t> splits;
+  atomic<uint64_t> init_calls;
+  atomic<uint64_t> init_ns;
+  atomic<uint64_t> flip_ns;
+  atomic<uint64_t> pairs[3];      // current size of flips[k]
+  atomic<int> rank;
+
+  WalkStats();
+};
+
+// The counting macros compile to nothing unless FLIP_STATS is defined
+// ("make stats"). s is a WalkStats*, which may be NULL.
+#ifdef FLIP_STATS
+
+class StatTimer{
+  public:
+  atomic<uint64_t>* target;
+  chrono::steady_clock::time_point start;
+
+  StatTimer(atomic<uint64_t>* target) : target(target) {
+    if(target != NULL){
+      start = chrono::steady_clock::now();
+    }
+  }
+
+  ~StatTimer(){
+    if(target != NULL){
+      uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+      target->store(target->load(memory_order_relaxed) + ns, memory_order_relaxed);
+    }
+  }
+};
+
+#define STAT_ADD(s, field, n) do{ if(s) (s)->field.store((s)->field.load(memory_order_relaxed) + (n), memory_order_relaxed); }while(0)
+#define STAT_SET(s, field, v) do{ if(s) (s)->field.store((v), memory_order_relaxed); }while(0)
+#define STAT_TIME(s, field) StatTimer stat_timer_##field((s) ? &(s)->field : NULL)
+
+#else
+
+#define STAT_ADD(s, field, n) do{}while(0)
+#define STAT_SET(s, field, v) do{}while(0)
+#define STAT_TIME(s, field) do{}while(0)
+
+#endif
+
+bool stats_enabled();
+
+// Writes all walkers' counters and their totals as one line of JSON.
+void writestats(ostream &output, const vector<WalkStats*> &walkers, double seconds);
+
+// Writes the counters every interval seconds, if interval is positive, and
+// once more when stopped. Output goes to stderr when path is empty and is
+// otherwise appended to path.
+class StatsReporter{
+  public:
+  StatsReporter(const vector<WalkStats*> &walkers, double interval, string path);
+  ~StatsReporter();
+  void stop();
+
+  private:
+  vector<WalkStats*> walkers;
+  double interval;
+  string path;
+  chrono::steady_clock::time_point start;
+  mutex lock;
+  condition_variable wake;
+  bool stopped;
+  thread worker;
+
+  void report();
+  void run();
+};
+
+#endif
@@ -14,175 +14,329 @@ You should have received a copy of the GNU General Public License along with big
  **********************************************************************/
 
 #include "tensor.hpp"
+#include "scan.hpp"
 
 namespace{
   static const int plus1mod3[] = {1,2,0};
   static const int plus2mod3[] = {2,0,1};
 }
 
-Tensor::Tensor() {
+template<class F>
+Tensor<F>::Tensor() {
   rank = 0;
+  maxrank = 0;
   data = NULL;
   flips = NULL;
+  buckets = NULL;
+  stop_flag = NULL;
+  stats = NULL;
+  check_reductions = false;
+  checkpoint_epoch = NULL;
+  limits = NULL;
+  hashing = false;
+  hash = 0;
+  visited = NULL;
 }
 
-Tensor::~Tensor(){
+template<class F>
+Tensor<F>::~Tensor(){
   delete[] data;
   delete[] flips;
+  delete[] buckets;
 }
 
-Tensor::Tensor(const Tensor &t) {
+template<class F>
+Tensor<F>::Tensor(const Tensor<F> &t) {
   rank = t.rank;
-  data = new factor[3*rank];
-  for(int i = 0; i<3*rank; ++i){
-    data[i] = t.data[i];
+  maxrank = t.maxrank;
+  data = new F[3*maxrank];
+  for(int k = 0; k < 3; ++k){
+    for(int i = 0; i<rank; ++i){
+      get(i,k) = t.data[k*maxrank+i];
+    }
+  }
+  flips = NULL;
+  buckets = NULL;
+  if(t.flips != NULL){
+    flips = new PairSet[3];
+    buckets = new Buckets<F>[3];
+    for(int k = 0; k < 3; ++k){
+      flips[k] = t.flips[k];
+      buckets[k] = t.buckets[k];
+    }
   }
+  candidates = t.candidates;
+  stop_flag = NULL;
+  stats = NULL;
+  check_reductions = t.check_reductions;
+  checkpoint_epoch = NULL;
+  limits = t.limits;
+  hashing = t.hashing;
+  hash = t.hash;
+  rowhash = t.rowhash;
+  visited = NULL;
 }
 
-Tensor* Tensor::clone() const {
+template<class F>
+Tensor<F>* Tensor<F>::clone() const {
   return new Tensor(*this);
 }
 
-void Tensor::write(string filename){
+template<class F>
+void Tensor<F>::write(string filename){
   cerr << "write method for generic tensor object not implemented" << endl;
 }
 
 
-void Tensor::writetoconsole(){
+template<class F>
+void Tensor<F>::writetoconsole(){
   cerr << "write method for generic tensor object not implemented" << endl;
 }
 
-factor& Tensor::get(int row, int col){
-  return data[row*3+col];
+template<class F>
+F& Tensor<F>::get(int row, int col){
+  return data[col*maxrank+row];
 }
 
-bool Tensor::reduce(){
-  for(auto i = 0; i < flips[0].size(); ++i){
-    int r1 = flips[0].first(i);
-    int r2 = flips[0].second(i);
-    if(get(r1,1) == get(r2,1)){
-      get(r1,2) ^= get(r2,2);
-      remove(r2);
-      return true;
-    }
-    if(get(r1,2) == get(r2,2)){
-      get(r1,1) ^= get(r2,1);
+template<class F>
+F* Tensor<F>::column(int col){
+  return data + col*maxrank;
+}
+
+// Merges one pair of rows sharing two factors into a single row. The pairs
+// come from candidates, which init, flip, split and replace fill as they
+// find such pairs while updating the flip sets, so reduce never scans the
+// flip sets and a reduction found by flip is applied at that pair.
+template<class F>
+bool Tensor<F>::reduce(){
+  STAT_ADD(stats, reduce_calls, 1);
+  while(!candidates.empty()){
+    int r1 = candidates.back().first;
+    int r2 = candidates.back().second;
+    candidates.pop_back();
+    int col = reducecol(r1, r2);
+    if(col != -1){
+      replace(r1, col, get(r1,col) ^ get(r2,col));
       remove(r2);
+      STAT_ADD(stats, reductions, 1);
       return true;
     }
   }
-  for(auto i = 0; i < flips[1].size(); ++i){
-    int r1 = flips[1].first(i);
-    int r2 = flips[1].second(i);
-    if(get(r1,2) == get(r2,2)){
-      get(r1,0) ^= get(r2,0);
-      remove(r2);
-      return true;
+  return false;
+}
+
+// The column in which two rows sharing the other two factors differ, or -1
+// if they do not share two factors.
+template<class F>
+int Tensor<F>::reducecol(int row1, int row2){
+  bool same[3];
+  for(int k = 0; k < 3; ++k){
+    same[k] = get(row1,k) == get(row2,k);
+  }
+  if(same[0] && same[1]){
+    return 2;
+  }
+  if(same[0] && same[2]){
+    return 1;
+  }
+  if(same[1] && same[2]){
+    return 0;
+  }
+  return -1;
+}
+
+// Adds a pair of rows sharing two factors to candidates. Pairs that have
+// changed since they were added are dropped once the list gets long, which
+// only happens in walks without reductions.
+template<class F>
+void Tensor<F>::note(int row1, int row2){
+  if(candidates.size() >= (size_t)2*rank + 64){
+    size_t kept = 0;
+    for(auto &p : candidates){
+      if(reducecol(p.first, p.second) != -1){
+	candidates[kept++] = p;
+      }
     }
+    candidates.resize(kept);
   }
-  return false;
+  candidates.push_back(make_pair(row1, row2));
 }
 
-void Tensor::remove(int row){
-  data[3*row]=data[3*(rank-1)];
-  data[3*row+1]=data[3*(rank-1)+1];
-  data[3*row+2]=data[3*(rank-1)+2];
+// Drops a row by moving the last row into its place. Only the pairs of
+// these two rows are touched; the moved row keeps its pairs under its new
+// index.
+template<class F>
+void Tensor<F>::remove(int row){
+  int last = rank - 1;
+  if(hashing){
+    hash -= rowhash[row];
+    rowhash[row] = rowhash[last];
+  }
+  size_t kept = 0;
+  for(auto p : candidates){
+    if(p.first != row && p.second != row){
+      candidates[kept++] = make_pair(p.first == last ? row : p.first, p.second == last ? row : p.second);
+    }
+  }
+  candidates.resize(kept);
+  for(int k = 0; k < 3; ++k){
+    flips[k].remove(row);
+    buckets[k].erase(row, get(row,k));
+    if(row != last){
+      flips[k].relabel(last, row);
+      buckets[k].erase(last, get(last,k));
+      get(row,k) = get(last,k);
+      buckets[k].insert(row, get(row,k));
+    }
+  }
   --rank;
-  init();
 }
 
-void Tensor::remove_zero_rows(){
-  for(int i = 0; i < rank; ++i){
-    if(get(i,0) == 0 || get(i,1) == 0 || get(i,2) == 0){
-      remove(i);
-      --i;
+// Sets one factor and updates the pairs of that row in that column.
+template<class F>
+void Tensor<F>::replace(int row, int col, F value){
+  buckets[col].erase(row, get(row,col));
+  flips[col].remove(row);
+  get(row,col) = value;
+  int b = plus1mod3[col];
+  int c = plus2mod3[col];
+  for(int i = buckets[col].first(value); i != -1; i = buckets[col].after(i)){
+    flips[col].insert(i,row);
+    if(get(i,b) == get(row,b) || get(i,c) == get(row,c)){
+      note(row, i);
+    }
+  }
+  buckets[col].insert(row, value);
+  rehash(row);
+}
+
+template<class F>
+void Tensor<F>::rehash(int row){
+  if(!hashing){
+    return;
+  }
+  hash -= rowhash[row];
+  rowhash[row] = hashrow(get(row,0), get(row,1), get(row,2));
+  hash += rowhash[row];
+}
+
+template<class F>
+void Tensor<F>::remove_zero_rows(){
+  int words = (rank + 63)/64;
+  scratch.resize(2*words);
+  uint64_t* zero = scratch.data();
+  uint64_t* mask = zero + words;
+  F z(0);
+  eqmask(column(0), rank, z, zero);
+  for(int k = 1; k < 3; ++k){
+    eqmask(column(k), rank, z, mask);
+    for(int w = 0; w < words; ++w){
+      zero[w] |= mask[w];
+    }
+  }
+  // From the top down, so the row moved into a hole is already checked
+  for(int w = words - 1; w >= 0; --w){
+    while(zero[w] != 0){
+      int bit = 63 - __builtin_clzll(zero[w]);
+      zero[w] ^= (uint64_t)1 << bit;
+      remove(64*w + bit);
     }
   }
 }
 
-bool Tensor::flip(int col, int r1, int r2, bool reduce_flag){
+// Returns whether the flip made a reduction possible, in which case one
+// reduction is applied. All pairs of the changed factors are inserted
+// before reducing so the flip sets stay complete.
+template<class F>
+bool Tensor<F>::flip(int col, int r1, int r2, bool reduce_flag){
+  STAT_TIME(stats, flip_ns);
+  STAT_ADD(stats, flips, 1);
   int a = col;
   int b = plus1mod3[a];
   int c = plus2mod3[a];
+  bool reducible = false;
+  buckets[c].erase(r1, get(r1,c));
+  buckets[b].erase(r2, get(r2,b));
   get(r1,c) ^= get(r2,c);
   get(r2,b) ^= get(r1,b);
+  rehash(r1);
+  rehash(r2);
+  buckets[c].insert(r1, get(r1,c));
+  buckets[b].insert(r2, get(r2,b));
   flips[c].remove(r1);
   flips[b].remove(r2);
-  for(auto i = 0; i < rank; ++i){
-    if(i != r1 && get(i,c) == get(r1,c)){
+  for(int i = buckets[c].first(get(r1,c)); i != -1; i = buckets[c].after(i)){
+    if(i != r1){
       flips[c].insert(r1,i);
-      if(reduce_flag){
-	if(get(i,a) == get(r1,a)){
-	  reduce();
-	  return 1;
-	}
-	if(get(i,b) == get(r1,b)){
-	  reduce();
-	  return 1;
-	}
+      if(get(i,a) == get(r1,a) || get(i,b) == get(r1,b)){
+	reducible = true;
+	note(r1, i);
       }
     }
-    if(i != r2 && get(i,b) == get(r2,b)){
+  }
+  for(int i = buckets[b].first(get(r2,b)); i != -1; i = buckets[b].after(i)){
+    if(i != r2){
       flips[b].insert(r2,i);
-      if(reduce_flag){
-	if(get(i,a) == get(r2,a)){
-	  reduce();
-	  return 1;
-	}
-	if(get(i,c) == get(r2,c)){
-	  reduce();
-	  return 1;
-	}
+      if(get(i,a) == get(r2,a) || get(i,c) == get(r2,c)){
+	reducible = true;
+	note(r2, i);
       }
     }
   }
+  if(reduce_flag && reducible){
+    reduce();
+    return 1;
+  }
   return 0;
 }
 
-void Tensor::split(int col, int row1, int row2) {
+template<class F>
+void Tensor<F>::split(int col, int row1, int row2) {
   if (rank >= maxrank) {
     return;
   }
   int a = col;
   int b = plus1mod3[col];
   int c = plus2mod3[col];
-  get(rank,a) = get(row1,a)^get(row2,a);
+  int row = rank;
+  buckets[a].erase(row1, get(row1,a));
+  get(row,a) = get(row1,a)^get(row2,a);
   get(row1,a) = get(row2,a);
-  get(rank,b) = get(row1,b);
-  get(rank,c) = get(row1,c);
+  get(row,b) = get(row1,b);
+  get(row,c) = get(row1,c);
   rank++;
+  if(hashing){
+    rowhash[row] = 0;
+  }
+  rehash(row1);
+  rehash(row);
+  buckets[a].insert(row1, get(row1,a));
   flips[a].remove(row1);
-  for(auto i=0; i < rank-1; ++i) {
-    if(i != row1 && get(i,a) == get(row1,a)) {
+  for(int i = buckets[a].first(get(row1,a)); i != -1; i = buckets[a].after(i)) {
+    if(i != row1) {
       flips[a].insert(i,row1);
+      if(get(i,b) == get(row1,b) || get(i,c) == get(row1,c)) {
+        note(row1, i);
+      }
     }
-    if(get(i,a) == get(rank - 1,a)) {
-      flips[a].insert(i,rank - 1);
-    }
-    if(get(i,b) == get(rank - 1,b)) {
-      flips[b].insert(i,rank - 1);
-    }
-    if(get(i,c) == get(rank - 1,c)) {
-      flips[c].insert(i,rank - 1); 
+  }
+  for(int k = 0; k < 3; ++k) {
+    for(int i = buckets[k].first(get(row,k)); i != -1; i = buckets[k].after(i)) {
+      flips[k].insert(i,row);
+      if(get(i,plus1mod3[k]) == get(row,plus1mod3[k]) || get(i,plus2mod3[k]) == get(row,plus2mod3[k])) {
+        note(row, i);
+      }
     }
+    buckets[k].insert(row, get(row,k));
   }
 }
 
-string Tensor::newfilename(bool isLargeFormat){
-  factor s = 0;
-  for(auto i = 0; i < rank; ++i){
-    s+=get(i,0)+get(i,1)+get(i,2);
-    s<<=1;
-    s%=9223372036854775807;
-  }
-  stringstream stream;
-  if(isLargeFormat){
-    stream << "k" << setfill('0') << setw(15) << hex << s << ".lexp";
-  }else{
-    stream << "k" << setfill('0') << setw(15) << hex << s << ".exp";
-  }
-  string name = stream.str();
-  return name;
+// Named by the hash of the scheme, so equal schemes get the same name
+// whatever the order of their rows and different ones practically never
+// do. extension is ".exp", ".lexp" or ".bexp".
+template<class F>
+string Tensor<F>::newfilename(string extension){
+  return "k" + hexhash(schemehash()) + extension;
 }
 
 void writelog(string oldfilename, string newfilename, int steps, int oldrank, int rank){
@@ -194,63 +348,171 @@ void writelog(string oldfilename, string newfilename, int steps, int oldrank, in
   log.close();
 }
 
-bool Tensor::iscorrect(){
+template<class F>
+bool Tensor<F>::iscorrect(){
   return true;
 }
 
-void Tensor::init(){
+// Computes hash from scratch and keeps it up to date from then on. This
+// slows flips down by a tenth or more, so it is off until a caller
+// needs the hash.
+template<class F>
+void Tensor<F>::trackhash(){
+  hashing = true;
+  rowhash.resize(maxrank);
+  hash = 0;
+  for(int i = 0; i < rank; ++i){
+    rowhash[i] = hashrow(get(i,0), get(i,1), get(i,2));
+    hash += rowhash[i];
+  }
+}
+
+// hash, computed from scratch unless it is kept up to date.
+template<class F>
+__uint128_t Tensor<F>::schemehash(){
+  if(hashing){
+    return hash;
+  }
+  __uint128_t h = 0;
+  for(int i = 0; i < rank; ++i){
+    h += hashrow(get(i,0), get(i,1), get(i,2));
+  }
+  return h;
+}
+
+template<class F>
+void Tensor<F>::init(){
+  STAT_TIME(stats, init_ns);
+  STAT_ADD(stats, init_calls, 1);
+  if(hashing){
+    trackhash();
+  }
+  candidates.clear();
   for(int k = 0; k < 3; ++k){
     flips[k].clear();
+    buckets[k].reset(maxrank);
     for(int i = 0; i<rank; ++i){
-      for(int j = i+1; j<rank; ++j){
-	if(get(i,k) == get(j,k)){
-	  flips[k].insert(i,j);
+      for(int j = buckets[k].first(get(i,k)); j != -1; j = buckets[k].after(j)){
+	flips[k].insert(j,i);
+	if(get(j,plus1mod3[k]) == get(i,plus1mod3[k]) || get(j,plus2mod3[k]) == get(i,plus2mod3[k])){
+	  note(i, j);
 	}
       }
+      buckets[k].insert(i, get(i,k));
     }
   }
 }
 
-void Tensor::writetofile(bool isLargeFormat, int steps = -1){
-  string outputfilename = newfilename(isLargeFormat);
+template<class F>
+void Tensor<F>::writetofile(string extension, int steps){
+  string outputfilename = newfilename(extension);
   write(outputfilename);
   cout << outputfilename << "," << rank << endl;
   writelog(filename, outputfilename, steps, oldrank, rank);
 }
 
-void Tensor::randompath(int steps, mt19937 &gen, int split_distance, bool split, bool restart, bool isLargeFormat){
-  int init_rank = rank;
-  uniform_int_distribution<> coinflip(0, 1);
-  uniform_int_distribution<> d3(0, 2);
-  if(split){
-    while(!randomsplit(gen, coinflip, d3, split_distance));
+// Returns the number of flips done since the last reduction. The result is
+// left in the tensor; the caller decides whether to write it. The walk
+// returns early, without setting progress->finished, when it is cancelled,
+// on SIGINT or SIGTERM, or when checkpoint_epoch moves on; calling again
+// with the same progress carries on where it stopped.
+//
+// A walk with a visited filter ends when it is trapped (see VisitedFilter).
+// With limits, the walk ends when its time or flips run out, and with a
+// target rank it carries on after reductions, as with restart, until the
+// rank is at most the target.
+template<class F>
+int Tensor<F>::randompath(int steps, Rng &gen, int split_distance, bool split, bool restart, WalkProgress* progress){
+  WalkProgress local;
+  if(progress == NULL){
+    progress = &local;
   }
+  // Adds the time of this call to progress->seconds however it returns
+  struct Clock{
+    double &seconds;
+    chrono::steady_clock::time_point start;
+    double now() const { return seconds + chrono::duration<double>(chrono::steady_clock::now() - start).count(); }
+    ~Clock(){ seconds = now(); }
+  } clock = {progress->seconds, chrono::steady_clock::now()};
+  int target = limits != NULL ? limits->target_rank : -1;
+  if(progress->start_rank == -1){
+    progress->start_rank = rank;
+  }
+  int init_rank = progress->start_rank;
+  if(target >= 0 && rank <= target){
+    progress->finished = true;
+    return 0;
+  }
+  if(split && !progress->split_done){
+    while(!randomsplit(gen, split_distance));
+  }
+  progress->split_done = true;
   do{
     int i = 0;
-    for(i = 0; i<steps; ++i) {
+    for(i = progress->step; i<steps; ++i) {
+      if (termination_flag || (stop_flag != NULL && stop_flag->load(memory_order_relaxed))
+	  || (checkpoint_epoch != NULL && checkpoint_epoch->load(memory_order_relaxed) != progress->epoch)) {
+        progress->step = i;
+        return i;
+      }
+      // The clock is read every 256 flips only
+      if (limits != NULL && ((limits->flips > 0 && progress->flips >= limits->flips)
+	  || (limits->seconds > 0 && (progress->flips & 255) == 0 && clock.now() >= limits->seconds))) {
+        progress->step = i;
+        progress->finished = true;
+        return i;
+      }
       int size = flips[0].size() + flips[1].size() + flips[2].size();
-      if (size == 0) {
-        writetofile(isLargeFormat, i);
-        return;
+      if (size == 0 || (visited != NULL && visited->streak >= VisitedFilter::TRAPPED_STREAK)) {
+        progress->finished = true;
+        return i;
+      }
+      bool reduced = randomflip(gen, true);
+      ++progress->flips;
+      STAT_SET(stats, rank, rank);
+      for(int k = 0; k < 3; ++k){
+        STAT_SET(stats, pairs[k], flips[k].size());
       }
-      if (randomflip(gen, coinflip, true)) {
+      if (reduced) {
+        if (check_reductions && !iscorrect()) {
+          throw runtime_error("The scheme is incorrect after a reduction");
+        }
         break;
       }
     }
+    progress->step = 0;
     if (i == steps) {
-      writetofile(isLargeFormat, steps);
-      return;
+      progress->finished = true;
+      return steps;
     }
-  } while(restart || rank >= init_rank); // don't end because you reduced from a split! If you split, you need to reduce *AGAIN*
-  writetofile(isLargeFormat, steps);
-  return;
+  } while(target >= 0 ? rank > target : (restart || rank >= init_rank)); // don't end because you reduced from a split! If you split, you need to reduce *AGAIN*
+  progress->finished = true;
+  return steps;
+}
+
+// The hash the scheme would have after flip(col, row1, row2), before any
+// reduction.
+template<class F>
+__uint128_t Tensor<F>::fliphash(int col, int row1, int row2){
+  int a = col;
+  int b = plus1mod3[a];
+  int c = plus2mod3[a];
+  F f[3], g[3];
+  for(int k = 0; k < 3; ++k){
+    f[k] = get(row1,k);
+    g[k] = get(row2,k);
+  }
+  f[c] ^= g[c];
+  g[b] ^= f[b];
+  return hash - rowhash[row1] - rowhash[row2] + hashrow(f[0], f[1], f[2]) + hashrow(g[0], g[1], g[2]);
 }
 
-bool Tensor::randomflip(mt19937 &gen, uniform_int_distribution<> &coinflip, bool reduce_flag){
+// A uniformly random flip: a pair of rows sharing a factor and the order
+// in which they are flipped.
+template<class F>
+void Tensor<F>::randompair(Rng &gen, int &col, int &row1, int &row2){
   int size = flips[0].size() + flips[1].size() + flips[2].size();
-  uniform_int_distribution<> distribution(0, size - 1);
-  int r = distribution(gen);
-  int row1, row2, col;
+  int r = gen.below(size);
   if (r < flips[0].size()) {
     col = 0;
     row1 = flips[0].first(r);
@@ -264,34 +526,51 @@ bool Tensor::randomflip(mt19937 &gen, uniform_int_distribution<> &coinflip, bool
     row1 = flips[2].first(r - flips[0].size() - flips[1].size());
     row2 = flips[2].second(r - flips[0].size() - flips[1].size());
   }
-  if (coinflip(gen)) {
-    return flip(col, row1, row2, reduce_flag);
-  } else {
-    return flip(col, row2, row1, reduce_flag);
+  if (!gen.coin()) {
+    swap(row1, row2);
   }
 }
 
-bool Tensor::randomsplit(mt19937 &gen, uniform_int_distribution<> &coinflip, uniform_int_distribution<> &d3, int split_distance){
+// With a visited filter, up to 4 flips are drawn and the first one leading
+// to a scheme not in the filter is taken, or the last one if there is none.
+template<class F>
+bool Tensor<F>::randomflip(Rng &gen, bool reduce_flag){
+  int row1, row2, col;
+  randompair(gen, col, row1, row2);
+  if (visited != NULL) {
+    for (int tries = 1; tries < 4 && visited->contains((uint64_t)fliphash(col, row1, row2)); ++tries) {
+      randompair(gen, col, row1, row2);
+    }
+  }
+  bool reduced = flip(col, row1, row2, reduce_flag);
+  if (visited != NULL) {
+    visited->insert((uint64_t)hash);
+  }
+  return reduced;
+}
+
+template<class F>
+bool Tensor<F>::randomsplit(Rng &gen, int split_distance){
   if(rank >= maxrank){
     return true;
     cout << "maxrank reached" << endl;
   }
-  uniform_int_distribution<> row_distribution(0, rank - 1);
   int row1, row2;
   do{
-    row1 = row_distribution(gen);
-    row2 = row_distribution(gen);
+    row1 = gen.below(rank);
+    row2 = gen.below(rank);
   }
   while(row1 == row2);
-  int col = d3(gen);
+  int col = gen.below(3);
+  STAT_ADD(stats, splits, 1);
   split(col,row1,row2);
-  if(coinflip(gen)){
+  if(gen.coin()){
     flip(col, row1, row2, 0);
   } else {
     flip(col, row2, row1, 0);
   }
   for(int j = 0; j < split_distance; ++j){
-    randomflip(gen, coinflip, false);
+    randomflip(gen, false);
   }
   int previousrank = rank;
   remove_zero_rows();
@@ -302,3 +581,7 @@ bool Tensor::randomsplit(mt19937 &gen, uniform_int_distribution<> &coinflip, uni
   //  cout << "split successful" << endl;
   return true;
 }
+
+template class Tensor<factor>;
+template class Tensor<factor_big>;
+template class Tensor<factor_wide>;
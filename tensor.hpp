@@ -25,9 +25,18 @@ You should have received a copy of the GNU General Public License along with big
 #include <cstdlib>
 #include <stdlib.h>
 #include <sstream>
+#include <stdexcept>
 #include "pairSet.hpp"
+#include "buckets.hpp"
+#include "wide.hpp"
+#include "rng.hpp"
+#include "stats.hpp"
+#include "visited.hpp"
+#include "schemehash.hpp"
 #include <iomanip>
 #include <csignal>
+#include <atomic>
+#include <chrono>
 
 #ifdef DEBUG
 #define debug(msg) cerr << msg << endl
@@ -38,50 +47,109 @@ You should have received a copy of the GNU General Public License along with big
 using namespace std;
 
 typedef unsigned long long factor;
+typedef __uint128_t factor_big;
+typedef Wide<4> factor_wide;
+
+// hashrow of a row of a Tensor<F>, see schemehash.hpp.
+template<class F>
+inline __uint128_t hashrow(const F &a, const F &b, const F &c){
+  return hashrow((const uint64_t*)&a, (const uint64_t*)&b, (const uint64_t*)&c, sizeof(F)/8);
+}
 
 extern int oldrank;
 extern string filename;
 extern int correctness_check;
-//extern volatile sig_atomic_t termination_flag;
+extern volatile sig_atomic_t termination_flag;  // set on SIGINT or SIGTERM
+
+// How far randompath has got, so that it can return early and carry on
+// later, possibly in another process (see checkpoint.hpp).
+struct WalkProgress{
+  int step;        // flips since the last reduction
+  int start_rank;  // rank before the walk, -1 if it has not started
+  bool split_done; // the split at the start of the walk is done
+  bool finished;   // the walk has ended and will not carry on
+  unsigned epoch;  // the last checkpoint_epoch this walk has seen
+  long long flips; // flips over the whole walk
+  double seconds;  // time spent in randompath
+
+  WalkProgress() : step(0), start_rank(-1), split_done(false), finished(false), epoch(0), flips(0), seconds(0) {}
+};
+
+// Bounds on a whole walk, over all its restarts. They are checked against
+// WalkProgress, so they carry over when a walk resumes from a checkpoint.
+struct WalkLimits{
+  double seconds;   // wall-clock time, 0 for none
+  long long flips;  // flips, 0 for none
+  int target_rank;  // the walk ends once rank <= target_rank, -1 for none
 
+  WalkLimits() : seconds(0), flips(0), target_rank(-1) {}
+};
+
+// A tensor as a list of rank one terms over F_2. F is the word type holding
+// one factor; the class is instantiated in tensor.cpp for factor,
+// factor_big and factor_wide.
+template<class F>
 class Tensor{
 public:
   int rank;
   int maxrank;
-  factor* data;
+  F* data;  // column major: column k holds rows 0..maxrank-1 from data+k*maxrank
   PairSet* flips;
+  Buckets<F>* buckets;
+  vector<uint64_t> scratch;  // match masks from eqmask
+  vector<pair<int,int>> candidates; // every pair of rows sharing two factors, and maybe stale ones
+  atomic<bool>* stop_flag; // set by another walker to cancel randompath
+  WalkStats* stats;        // counters, only kept in builds with FLIP_STATS
+  bool check_reductions;   // call iscorrect after every reduction of randompath
+  const atomic<unsigned>* checkpoint_epoch; // randompath pauses when it changes
+  const WalkLimits* limits; // bounds on randompath, none if NULL
+  bool hashing;            // keep hash and rowhash up to date, see trackhash
+  __uint128_t hash;        // sum of rowhash over the rows
+  vector<__uint128_t> rowhash; // hashrow of each row
+  VisitedFilter* visited;  // randomflip prefers flips to schemes not in it, if not NULL
 
   Tensor();
   Tensor(const Tensor &t);
   
-  ~Tensor();
+  virtual ~Tensor();
 
   virtual Tensor* clone() const;
   
   virtual void write(string filename);
   virtual void writetoconsole();
   
-  virtual string newfilename(bool isLargeFormat);
-  void writetofile(bool isLargeFormat, int);
+  virtual string newfilename(string extension);
+  void writetofile(string extension, int steps = -1);
 
-  factor& get(int, int);
+  F& get(int, int);
+  F* column(int col);
   void remove(int);
+  void replace(int row, int col, F value);
   void init();
+  void trackhash();
 
   bool flip(int col, int row1, int row2, bool reduce_flag = true);
   void split(int col, int row1, int row2);
   bool reduce();
   void remove_zero_rows();
 
-  bool randomflip(mt19937 &gen, uniform_int_distribution<> &coinflip, bool reduce_flag = true);
+  __uint128_t schemehash();
+  __uint128_t fliphash(int col, int row1, int row2);
+  bool randomflip(Rng &gen, bool reduce_flag = true);
   
-  void randompath(int steps, mt19937 &gen, int split_distance, bool split, bool restart, bool isLargeFormat);
-  bool randomsplit(mt19937 &gen, uniform_int_distribution<> &coinflip, uniform_int_distribution<> &d3, int split_distance);
+  int randompath(int steps, Rng &gen, int split_distance, bool split, bool restart, WalkProgress* progress = NULL);
+  bool randomsplit(Rng &gen, int split_distance);
 
   virtual bool iscorrect();
+
+private:
+  void rehash(int row);
+  int reducecol(int row1, int row2);
+  void note(int row1, int row2);
+  void randompair(Rng &gen, int &col, int &row1, int &row2);
 };
 
-void writelog(string, string, int, int);
+void writelog(string, string, int, int, int);
 
 
 
@@ -0,0 +1,92 @@
+/***********************************************************************
+visited.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef visited_hpp__
+#define visited_hpp__
+
+#include<cstdint>
+#include<vector>
+
+using namespace std;
+
+// The schemes a walk has visited recently, as a Bloom filter over their
+// hashes (Tensor::hash). Each hash sets 4 bits picked by double hashing
+// from its two halves. There are two generations of 2^log2bits bits each:
+// once the current one holds bits/8 hashes, where about 2% of lookups of
+// new schemes are false positives, it becomes the previous one and a cleared
+// generation takes its place. Lookups check both, so the filter remembers
+// between bits/8 and bits/4 of the latest schemes.
+//
+// A long streak of revisits means the walk goes round a closed part of the
+// flip graph, which it has searched for reductions already; randompath ends
+// the walk once streak reaches TRAPPED_STREAK.
+class VisitedFilter{
+  public:
+  static const uint64_t TRAPPED_STREAK = 1 << 16;
+
+  uint64_t added;     // hashes inserted
+  uint64_t revisits;  // hashes inserted that were already present
+  uint64_t streak;    // hashes inserted in a row that were already present
+
+  VisitedFilter(int log2bits) : added(0), revisits(0), streak(0), current(0), count(0) {
+    int bits = log2bits < 9 ? 9 : log2bits;
+    mask = ((uint64_t)1 << bits) - 1;
+    capacity = ((uint64_t)1 << bits) / 8;
+    words[0].assign(((uint64_t)1 << bits) / 64, 0);
+    words[1].assign(words[0].size(), 0);
+  }
+
+  bool contains(uint64_t hash) const {
+    return test(words[current], hash) || test(words[current ^ 1], hash);
+  }
+
+  void insert(uint64_t hash){
+    ++added;
+    if(contains(hash)){
+      ++revisits;
+      ++streak;
+    }else{
+      streak = 0;
+    }
+    if(count == capacity){
+      current ^= 1;
+      words[current].assign(words[current].size(), 0);
+      count = 0;
+    }
+    uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for(int i = 0; i < 4; ++i, hash += step){
+      words[current][(hash & mask) >> 6] |= (uint64_t)1 << (hash & 63);
+    }
+    ++count;
+  }
+
+  private:
+  vector<uint64_t> words[2];
+  int current;
+  uint64_t mask;
+  uint64_t capacity;  // hashes per generation
+  uint64_t count;     // hashes in the current generation
+
+  bool test(const vector<uint64_t> &w, uint64_t hash) const {
+    uint64_t step = (hash >> 32 | hash << 32) | 1;
+    for(int i = 0; i < 4; ++i, hash += step){
+      if(!(w[(hash & mask) >> 6] >> (hash & 63) & 1)){
+	return false;
+      }
+    }
+    return true;
+  }
+};
+
+#endif
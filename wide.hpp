@@ -0,0 +1,177 @@
+/***********************************************************************
+wide.hpp
+
+Copyright 2025 Isaac Wood
+
+This file is part of bigger_flips.
+
+bigger_flips is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+
+bigger_flips is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with bigger_flips. If not, see <https://www.gnu.org/licenses/>.
+ **********************************************************************/
+
+#ifndef wide_hpp__
+#define wide_hpp__
+
+#include<cstdint>
+#include<cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+// A bit set of W 64-bit words with the operators Tensor and MatMul use on
+// a factor. Word 0 holds bits 0 to 63. Equality, xor and hashing use AVX2
+// or SSE2 when the compiler targets them and plain words otherwise. The
+// binary operators are friends so that 0 and 1 convert implicitly.
+template<int W>
+struct Wide{
+  uint64_t w[W];
+
+  Wide() {}
+
+  Wide(unsigned long long x){
+    w[0] = x;
+    for(int i = 1; i < W; ++i){
+      w[i] = 0;
+    }
+  }
+
+  Wide& operator^=(const Wide &o){
+    int i = 0;
+#ifdef __AVX2__
+    for(; i + 4 <= W; i += 4){
+      __m256i x = _mm256_loadu_si256((const __m256i*)(w + i));
+      __m256i y = _mm256_loadu_si256((const __m256i*)(o.w + i));
+      _mm256_storeu_si256((__m256i*)(w + i), _mm256_xor_si256(x, y));
+    }
+#endif
+#ifdef __SSE2__
+    for(; i + 2 <= W; i += 2){
+      __m128i x = _mm_loadu_si128((const __m128i*)(w + i));
+      __m128i y = _mm_loadu_si128((const __m128i*)(o.w + i));
+      _mm_storeu_si128((__m128i*)(w + i), _mm_xor_si128(x, y));
+    }
+#endif
+    for(; i < W; ++i){
+      w[i] ^= o.w[i];
+    }
+    return *this;
+  }
+
+  Wide& operator&=(const Wide &o){
+    for(int i = 0; i < W; ++i){
+      w[i] &= o.w[i];
+    }
+    return *this;
+  }
+
+  Wide& operator|=(const Wide &o){
+    for(int i = 0; i < W; ++i){
+      w[i] |= o.w[i];
+    }
+    return *this;
+  }
+
+  Wide operator~() const {
+    Wide r;
+    for(int i = 0; i < W; ++i){
+      r.w[i] = ~w[i];
+    }
+    return r;
+  }
+
+  Wide operator<<(int s) const {
+    Wide r(0);
+    int q = s / 64;
+    int b = s % 64;
+    for(int i = W - 1; i >= q; --i){
+      r.w[i] = w[i - q] << b;
+      if(b != 0 && i - q - 1 >= 0){
+	r.w[i] |= w[i - q - 1] >> (64 - b);
+      }
+    }
+    return r;
+  }
+
+  friend Wide operator^(Wide a, const Wide &b){
+    return a ^= b;
+  }
+
+  friend Wide operator&(Wide a, const Wide &b){
+    return a &= b;
+  }
+
+  friend Wide operator|(Wide a, const Wide &b){
+    return a |= b;
+  }
+
+  friend bool operator==(const Wide &a, const Wide &b){
+    int i = 0;
+#ifdef __AVX2__
+    for(; i + 4 <= W; i += 4){
+      __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a.w + i)),
+				   _mm256_loadu_si256((const __m256i*)(b.w + i)));
+      if(!_mm256_testz_si256(x, x)){
+	return false;
+      }
+    }
+#endif
+#ifdef __SSE2__
+    for(; i + 2 <= W; i += 2){
+      __m128i x = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a.w + i)),
+				 _mm_loadu_si128((const __m128i*)(b.w + i)));
+      if(_mm_movemask_epi8(x) != 0xFFFF){
+	return false;
+      }
+    }
+#endif
+    for(; i < W; ++i){
+      if(a.w[i] != b.w[i]){
+	return false;
+      }
+    }
+    return true;
+  }
+
+  friend bool operator!=(const Wide &a, const Wide &b){
+    return !(a == b);
+  }
+};
+
+// Multiplies each word by its own odd constant and folds the words, so
+// permuting the words changes the hash.
+template<int W>
+inline uint64_t hashfactor(const Wide<W> &x){
+  static const uint64_t k[4] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL,
+				0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL};
+  uint64_t h = 0;
+  int i = 0;
+#ifdef __AVX2__
+  const __m256i klo = _mm256_setr_epi64x(k[0], k[1], k[2], k[3]);
+  const __m256i khi = _mm256_srli_epi64(klo, 32);
+  __m256i acc = _mm256_setzero_si256();
+  for(; i + 4 <= W; i += 4){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(x.w + i));
+    // 64-bit lane product modulo 2^64 from 32-bit multiplies
+    __m256i lo = _mm256_mul_epu32(v, klo);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(v, 32), klo),
+				     _mm256_mul_epu32(v, khi));
+    acc = _mm256_xor_si256(_mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32)),
+			   _mm256_slli_epi64(acc, 7));
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, acc);
+  h = lanes[0] ^ lanes[1] ^ lanes[2] ^ lanes[3];
+#endif
+  for(; i < W; ++i){
+    h = (h << 7 | h >> 57) ^ (x.w[i] * k[i % 4]);
+  }
+  h ^= h >> 31;
+  h *= 0x9E3779B97F4A7C15ULL;
+  return h ^ (h >> 29);
+}
+
+#endif